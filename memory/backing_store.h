@@ -0,0 +1,204 @@
+// Sparse backing store for a full 64 bit simulated address space.
+//
+// Memory is kept as 4 KB pages that are allocated on first write. Pages are
+// found through an open addressing hash table keyed by page number, with the
+// last page used cached in front of it, and are carved out of large chunks
+// by a pool so allocation stays cheap. Memory use follows the touched
+// footprint, not the address range.
+
+#ifndef BACKING_STORE_H
+#define BACKING_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class PagedMemory
+{
+public:
+    static const unsigned PAGE_BITS = 12;
+    static const std::size_t PAGE_BYTES = std::size_t(1) << PAGE_BITS;
+    static const std::size_t PAGE_WORDS = PAGE_BYTES / 4;
+    static const std::size_t PAGES_PER_CHUNK = 64;
+
+    // value of a word that was never written, given its word address
+    using Initializer = int (*)(std::uint64_t wordAddress);
+
+    struct Page
+    {
+        int words[PAGE_WORDS];
+    };
+
+    explicit PagedMemory(Initializer initializer = nullptr) : initializer(initializer)
+    {
+        clear();
+    }
+
+    // drop every page
+    void clear()
+    {
+        slots.assign(16, Slot());
+        used = 0;
+        chunks.clear();
+        chunkFree = 0;
+        lastPage = ~std::uint64_t(0);
+        lastData = nullptr;
+    }
+
+    void setInitializer(Initializer function)
+    {
+        initializer = function;
+    }
+
+    // words are addressed by word number, byte address / 4
+    int read(std::uint64_t wordAddress) const
+    {
+        const Page *page = find(wordAddress / PAGE_WORDS);
+        if (page)
+            return page->words[wordAddress % PAGE_WORDS];
+        return initialValue(wordAddress);
+    }
+
+    void write(std::uint64_t wordAddress, int value)
+    {
+        page(wordAddress / PAGE_WORDS)->words[wordAddress % PAGE_WORDS] = value;
+    }
+
+    std::size_t pagesTouched() const { return used; }
+    std::size_t bytesAllocated() const { return chunks.size() * PAGES_PER_CHUNK * PAGE_BYTES; }
+
+    // visit every allocated page in no particular order
+    template <class Visitor>
+    void forEachPage(Visitor visit) const
+    {
+        for (const Slot &slot : slots)
+        {
+            if (slot.page)
+                visit(slot.number, *slot.page);
+        }
+    }
+
+    // checkpoint state, see checkpoint.h: the page count, then the number
+    // and words of each page
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        std::uint64_t count = used;
+        archive(count);
+        if constexpr (Archive::LOADING)
+        {
+            clear();
+            for (std::uint64_t i = 0; i < count && archive.good(); ++i)
+            {
+                std::uint64_t number = 0;
+                archive(number);
+                archive(page(number)->words);
+            }
+        }
+        else
+        {
+            forEachPage([&archive](std::uint64_t number, const Page &page) { archive(number, page.words); });
+        }
+    }
+
+    // page for the page number, allocated and initialized on first use
+    Page *page(std::uint64_t number)
+    {
+        if (number == lastPage)
+            return lastData;
+
+        std::size_t mask = slots.size() - 1;
+        std::size_t i = hash(number) & mask;
+        while (slots[i].page && slots[i].number != number)
+            i = (i + 1) & mask;
+
+        if (!slots[i].page)
+        {
+            // keep the table at most half full
+            if ((used + 1) * 2 > slots.size())
+            {
+                grow();
+                return page(number);
+            }
+            slots[i].number = number;
+            slots[i].page = allocatePage(number);
+            used++;
+        }
+
+        lastPage = number;
+        lastData = slots[i].page;
+        return lastData;
+    }
+
+private:
+    struct Slot
+    {
+        std::uint64_t number = 0;
+        Page *page = nullptr;
+    };
+
+    static std::size_t hash(std::uint64_t number)
+    {
+        // Fibonacci hashing spreads consecutive page numbers
+        return std::size_t((number * 0x9E3779B97F4A7C15ull) >> 20);
+    }
+
+    int initialValue(std::uint64_t wordAddress) const
+    {
+        return initializer ? initializer(wordAddress) : 0;
+    }
+
+    const Page *find(std::uint64_t number) const
+    {
+        if (number == lastPage)
+            return lastData;
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash(number) & mask; slots[i].page; i = (i + 1) & mask)
+        {
+            if (slots[i].number == number)
+                return slots[i].page;
+        }
+        return nullptr;
+    }
+
+    Page *allocatePage(std::uint64_t number)
+    {
+        if (chunkFree == 0)
+        {
+            chunks.emplace_back(new Page[PAGES_PER_CHUNK]);
+            chunkFree = PAGES_PER_CHUNK;
+        }
+        Page *fresh = &chunks.back()[PAGES_PER_CHUNK - chunkFree--];
+        std::uint64_t base = number * PAGE_WORDS;
+        for (std::size_t i = 0; i < PAGE_WORDS; ++i)
+            fresh->words[i] = initialValue(base + i);
+        return fresh;
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        std::size_t mask = slots.size() - 1;
+        for (const Slot &slot : old)
+        {
+            if (!slot.page)
+                continue;
+            std::size_t i = hash(slot.number) & mask;
+            while (slots[i].page)
+                i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+    }
+
+    Initializer initializer;
+    std::vector<Slot> slots;
+    std::size_t used = 0;
+    std::vector<std::unique_ptr<Page[]>> chunks;
+    std::size_t chunkFree = 0;
+    std::uint64_t lastPage;
+    Page *lastData;
+};
+
+#endif
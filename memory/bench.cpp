@@ -0,0 +1,329 @@
+// Simulator throughput benchmark.
+// Generates each synthetic pattern of workload.h at each footprint and times
+// every engine path over it, reporting simulated accesses per second and
+// nanoseconds per access. The best of --repeat runs is kept.
+//
+// usage: bench [--accesses N] [--footprint BYTES[,BYTES...]] [--pattern NAME]
+//              [--path NAME] [--repeat N] [--seed N] [--out FILE]
+//              [--baseline FILE] [--tolerance PERCENT]
+//
+// Paths:
+//   lookup          tag lookups in a warmed 32 KB 8-way L1, no updates
+//   replace-POLICY  lookup, history update and fill on a miss, per policy
+//   hierarchy       32 KB L1, 512 KB L2 and 8 MB LLC, non-inclusive
+//   timing          the LRU L1 feeding the MSHR timing model
+//   simulator       the default CacheSimulator of simulator.h over the
+//                   unmodified trace; its misses are n/a when the build
+//                   has SIM_STATS=0
+//
+// --out writes the results as CSV. --baseline compares against such a file
+// and marks rows slower by more than the tolerance, 10% by default; the
+// exit status is 2 when there are any.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "cache.h"
+#include "hierarchy.h"
+#include "simulator.h"
+#include "timing.h"
+#include "workload.h"
+
+using namespace std;
+
+const unsigned BENCH_ADDR_BITS = 48;
+
+template <template <size_t, size_t> class Policy = LRUPolicy>
+using BenchL1 = Cache<64, 8, 64, BENCH_ADDR_BITS, Policy>;
+using BenchL2 = Cache<1024, 8, 64, BENCH_ADDR_BITS>;
+using BenchLLC = Cache<8192, 16, 64, BENCH_ADDR_BITS>;
+
+struct PathResult
+{
+    uint64_t misses = 0;
+    bool counted = true; // false when the path cannot count its misses
+    double seconds = 0;
+};
+
+struct BenchPath
+{
+    string name;
+    PathResult (*run)(const vector<Access> &trace);
+};
+
+// results no path returns, stored so the work is not optimized away
+volatile uint64_t benchSink;
+
+double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// one access to the cache, allocating on every miss, true on a hit
+template <class CacheType>
+inline bool touch(CacheType &cache, const Access &access)
+{
+    size_t index = CacheType::getIndex(access.address);
+    typename CacheType::Tag tag = CacheType::getTag(access.address);
+    int block = cache.lookup(index, tag);
+    bool hit = block != -1;
+    if (!hit)
+    {
+        block = cache.findVictim(index);
+        cache.fill(index, block, tag);
+    }
+    else
+    {
+        cache.updateHistory(index, block);
+    }
+    if (access.isWrite)
+        cache.setDirty(index, block);
+    return hit;
+}
+
+PathResult runLookup(const vector<Access> &trace)
+{
+    BenchL1<> cache;
+    for (const Access &access : trace)
+        touch(cache, access);
+
+    PathResult result;
+    auto start = chrono::steady_clock::now();
+    for (const Access &access : trace)
+        result.misses += cache.lookup(BenchL1<>::getIndex(access.address), BenchL1<>::getTag(access.address)) == -1;
+    result.seconds = secondsSince(start);
+    return result;
+}
+
+template <template <size_t, size_t> class Policy>
+PathResult runReplacement(const vector<Access> &trace)
+{
+    BenchL1<Policy> cache;
+    PathResult result;
+    auto start = chrono::steady_clock::now();
+    for (const Access &access : trace)
+        result.misses += !touch(cache, access);
+    result.seconds = secondsSince(start);
+    return result;
+}
+
+PathResult runHierarchy(const vector<Access> &trace)
+{
+    Hierarchy<BenchL1<>, BenchL2, BenchLLC> levels;
+    levels.configure("L1", Inclusion::NINE);
+    levels.next().configure("L2", Inclusion::NINE);
+    levels.next().next().configure("LLC", Inclusion::NINE);
+
+    PathResult result;
+    auto start = chrono::steady_clock::now();
+    for (const Access &access : trace)
+    {
+        BackInvalidations invalidations;
+        bool dirty = false;
+        if (access.isWrite)
+            levels.write(access.address, invalidations);
+        else
+            levels.read(access.address, invalidations, dirty);
+    }
+    result.seconds = secondsSince(start);
+    result.misses = levels.stats.reads + levels.stats.writes - levels.stats.readHits - levels.stats.writeHits;
+    return result;
+}
+
+PathResult runTiming(const vector<Access> &trace)
+{
+    BenchL1<> cache;
+    Timing timing;
+    PathResult result;
+    auto start = chrono::steady_clock::now();
+    for (const Access &access : trace)
+    {
+        bool hit = touch(cache, access);
+        result.misses += !hit;
+        timing.access(access.address >> BenchL1<>::OFFSET_BITS, hit, !hit, 100);
+    }
+    result.seconds = secondsSince(start);
+    benchSink = timing.cycles();
+    return result;
+}
+
+PathResult runSimulator(const vector<Access> &trace)
+{
+    SimulatorConfig config;
+    CacheSimulator sim(config);
+    PathResult result;
+    auto start = chrono::steady_clock::now();
+    for (const Access &access : trace)
+        sim.access(access.address, access.isWrite, 1);
+    sim.flush();
+    result.seconds = secondsSince(start);
+    result.misses = sim.statistics().loadMisses + sim.statistics().storeMisses;
+    result.counted = Stats::ENABLED;
+    return result;
+}
+
+vector<BenchPath> allPaths()
+{
+    return {{"lookup", &runLookup},
+            {string("replace-") + LRUPolicy<1, 1>::name(), &runReplacement<LRUPolicy>},
+            {string("replace-") + TreePLRUPolicy<1, 2>::name(), &runReplacement<TreePLRUPolicy>},
+            {string("replace-") + SRRIPPolicy<1, 1>::name(), &runReplacement<SRRIPPolicy>},
+            {string("replace-") + BRRIPPolicy<1, 1>::name(), &runReplacement<BRRIPPolicy>},
+            {string("replace-") + FIFOPolicy<1, 1>::name(), &runReplacement<FIFOPolicy>},
+            {string("replace-") + RandomPolicy<1, 1>::name(), &runReplacement<RandomPolicy>},
+            {"hierarchy", &runHierarchy},
+            {"timing", &runTiming},
+            {"simulator", &runSimulator}};
+}
+
+// ns per access of a previous --out file, keyed by pattern, footprint and path
+map<string, double> readBaseline(const string &fileName)
+{
+    map<string, double> baseline;
+    ifstream in(fileName);
+    string line;
+    getline(in, line); // header
+    while (getline(in, line))
+    {
+        vector<string> fields;
+        stringstream row(line);
+        string field;
+        while (getline(row, field, ','))
+            fields.push_back(field);
+        if (fields.size() >= 8)
+            baseline[fields[0] + "," + fields[1] + "," + fields[2]] = strtod(fields[7].c_str(), nullptr);
+    }
+    return baseline;
+}
+
+int main(int argc, char *argv[])
+{
+    WorkloadConfig workload;
+    workload.count = 1 << 20;
+    vector<uint64_t> footprints = {16 << 10, 1 << 20, 64 << 20};
+    string patternFilter, pathFilter, outFile, baselineFile;
+    unsigned repeat = 3;
+    double tolerance = 10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--accesses" && i + 1 < argc)
+            workload.count = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--footprint" && i + 1 < argc)
+        {
+            footprints.clear();
+            for (char *p = argv[++i]; *p;)
+            {
+                footprints.push_back(strtoull(p, &p, 10));
+                if (*p == ',')
+                    p++;
+                else
+                    break;
+            }
+        }
+        else if (arg == "--pattern" && i + 1 < argc)
+            patternFilter = argv[++i];
+        else if (arg == "--path" && i + 1 < argc)
+            pathFilter = argv[++i];
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = unsigned(strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--seed" && i + 1 < argc)
+            workload.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--out" && i + 1 < argc)
+            outFile = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc)
+            baselineFile = argv[++i];
+        else if (arg == "--tolerance" && i + 1 < argc)
+            tolerance = strtod(argv[++i], nullptr);
+        else
+        {
+            cerr << "usage: " << argv[0] << " [--accesses N] [--footprint BYTES[,BYTES...]] [--pattern NAME] [--path NAME]"
+                 << " [--repeat N] [--seed N] [--out FILE] [--baseline FILE] [--tolerance PERCENT]" << endl;
+            return 1;
+        }
+    }
+    Pattern filtered = Pattern::Sequential;
+    if (!patternFilter.empty() && !parsePattern(patternFilter, filtered))
+    {
+        cerr << "unknown pattern " << patternFilter << endl;
+        return 1;
+    }
+    repeat = repeat ? repeat : 1;
+
+    map<string, double> baseline;
+    if (!baselineFile.empty())
+        baseline = readBaseline(baselineFile);
+    ofstream csv;
+    if (!outFile.empty())
+    {
+        csv.open(outFile);
+        csv << fixed << "pattern,footprint,path,accesses,misses,seconds,accesses_per_second,ns_per_access\n";
+    }
+
+    cout << "Pattern\tFootprint\tPath\tAccesses\tMiss ratio\tMacc/s\tns/acc" << (baseline.empty() ? "" : "\tvs base") << endl;
+    int regressions = 0;
+    for (int p = 0; p < PATTERN_COUNT; ++p)
+    {
+        workload.pattern = Pattern(p);
+        if (!patternFilter.empty() && workload.pattern != filtered)
+            continue;
+        for (uint64_t footprint : footprints)
+        {
+            workload.footprint = footprint;
+            const vector<Access> trace = generateWorkload(workload);
+            for (const BenchPath &path : allPaths())
+            {
+                if (!pathFilter.empty() && path.name != pathFilter)
+                    continue;
+
+                PathResult best;
+                for (unsigned r = 0; r < repeat; ++r)
+                {
+                    PathResult result = path.run(trace);
+                    if (r == 0 || result.seconds < best.seconds)
+                        best = result;
+                }
+                double perSecond = best.seconds > 0 ? trace.size() / best.seconds : 0.0;
+                double ns = trace.empty() ? 0.0 : best.seconds * 1e9 / trace.size();
+
+                cout << patternName(workload.pattern) << "\t" << footprint << "\t" << path.name << "\t" << trace.size() << "\t";
+                if (best.counted)
+                    cout << fixed << setprecision(4) << (trace.empty() ? 0.0 : double(best.misses) / trace.size());
+                else
+                    cout << "n/a";
+                cout << "\t" << fixed << setprecision(1) << perSecond / 1e6 << "\t" << setprecision(2) << ns;
+                string key = string(patternName(workload.pattern)) + "," + to_string(footprint) + "," + path.name;
+                auto previous = baseline.find(key);
+                if (previous != baseline.end() && previous->second > 0)
+                {
+                    double change = (ns / previous->second - 1) * 100;
+                    bool slower = change > tolerance;
+                    regressions += slower;
+                    cout << "\t" << showpos << setprecision(1) << change << "%" << noshowpos << (slower ? " REGRESSION" : "");
+                }
+                cout << endl;
+                if (csv.is_open())
+                {
+                    csv << key << "," << trace.size() << ",";
+                    if (best.counted)
+                        csv << best.misses;
+                    else
+                        csv << "n/a";
+                    csv << "," << setprecision(6) << best.seconds << ","
+                        << setprecision(0) << perSecond << "," << setprecision(3) << ns << "\n";
+                }
+            }
+        }
+    }
+    if (regressions)
+        cerr << regressions << " paths slower than the baseline by more than " << tolerance << "%" << endl;
+    return regressions ? 2 : 0;
+}
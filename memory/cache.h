@@ -0,0 +1,234 @@
+// Set-associative cache with a compile-time geometry.
+// Index, tag and offset shifts and masks are all computed from the template
+// arguments, so every configuration compiles to its own specialized code.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "replacement.h"
+#include "tag_match.h"
+
+// log2 of a power of two
+constexpr unsigned log2Exact(std::size_t n)
+{
+    return n <= 1 ? 0 : 1 + log2Exact(n / 2);
+}
+
+constexpr bool isPowerOfTwo(std::size_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+// mask with the low n bits set
+constexpr std::uint64_t lowMask(unsigned n)
+{
+    return n >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1;
+}
+
+// smallest unsigned integer type that holds the given number of bits
+template <unsigned Bits>
+using UintFor = typename std::conditional<Bits <= 8, std::uint8_t,
+                typename std::conditional<Bits <= 16, std::uint16_t,
+                typename std::conditional<Bits <= 32, std::uint32_t, std::uint64_t>::type>::type>::type;
+
+// Sets:      number of sets
+// Ways:      blocks per set
+// LineBytes: bytes per block, a multiple of the 4 byte word
+// AddrBits:  width of the byte address seen by the cache
+// Policy:    replacement policy, see replacement.h
+template <std::size_t Sets, std::size_t Ways, std::size_t LineBytes, unsigned AddrBits,
+          template <std::size_t, std::size_t> class Policy = LRUPolicy>
+class Cache
+{
+public:
+    static_assert(isPowerOfTwo(Sets), "set count must be a power of two");
+    static_assert(Ways >= 1 && Ways <= 64, "associativity must be between 1 and 64");
+    static_assert(isPowerOfTwo(LineBytes) && LineBytes >= 4, "line size must be a power of two of at least one word");
+    static_assert(AddrBits <= 64, "addresses are at most 64 bits");
+
+    using Address = std::uint64_t;
+
+    static constexpr unsigned ADDR_BITS = AddrBits;
+    static constexpr std::size_t SETS = Sets;
+    static constexpr std::size_t WAYS = Ways;
+    static constexpr std::size_t LINE_BYTES = LineBytes;
+    static constexpr std::size_t WORDS_PER_LINE = LineBytes / 4;
+    static constexpr std::size_t BLOCKS = Sets * Ways;
+    static constexpr std::size_t SIZE_BYTES = Sets * Ways * LineBytes;
+
+    // address layout: | tag | index | offset |
+    static constexpr unsigned OFFSET_BITS = log2Exact(LineBytes);
+    static constexpr unsigned INDEX_BITS = log2Exact(Sets);
+    static_assert(OFFSET_BITS + INDEX_BITS <= AddrBits, "address too narrow for this geometry");
+    static constexpr unsigned TAG_BITS = AddrBits - OFFSET_BITS - INDEX_BITS;
+    static constexpr unsigned INDEX_SHIFT = OFFSET_BITS;
+    static constexpr unsigned TAG_SHIFT = OFFSET_BITS + INDEX_BITS;
+    static constexpr Address OFFSET_MASK = lowMask(OFFSET_BITS);
+    static constexpr Address INDEX_MASK = lowMask(INDEX_BITS);
+    static constexpr Address TAG_MASK = lowMask(TAG_BITS);
+
+    using Tag = UintFor<TAG_BITS == 0 ? 1 : TAG_BITS>;
+
+    // one bit per way, used for the valid and dirty bits of a set
+    using WayMask = UintFor<Ways>;
+    static constexpr WayMask ALL_WAYS = WayMask(lowMask(Ways));
+
+    // the tags of a set sit next to each other, aligned so that a row never
+    // straddles a 64 byte host cache line and can be loaded as whole vectors
+    static constexpr std::size_t TAG_ROW_ALIGN = Ways * sizeof(Tag) >= 64 ? 64 : std::size_t(1) << log2Exact(2 * Ways * sizeof(Tag) - 1);
+
+    struct alignas(TAG_ROW_ALIGN) TagRow
+    {
+        Tag way[Ways];
+    };
+
+    using ReplacementPolicy = Policy<Sets, Ways>;
+
+    Cache() : tags(Sets), valid(Sets, 0), dirty(Sets, 0) {}
+
+    static std::size_t getIndex(Address address)
+    {
+        return (address >> INDEX_SHIFT) & INDEX_MASK;
+    }
+
+    static Tag getTag(Address address)
+    {
+        return Tag((address >> TAG_SHIFT) & TAG_MASK);
+    }
+
+    // word within the block
+    static std::size_t getWord(Address address)
+    {
+        return (address & OFFSET_MASK) >> 2;
+    }
+
+    // byte address of the first word of a block
+    static Address getBlockAddress(std::size_t index, Tag tag)
+    {
+        return (Address(tag) << TAG_SHIFT) | (Address(index) << INDEX_SHIFT);
+    }
+
+    Tag getTag(std::size_t index, int way) const
+    {
+        return tags[index].way[way];
+    }
+
+    WayMask validMask(std::size_t index) const
+    {
+        return valid[index];
+    }
+
+    bool isValid(std::size_t index, int way) const
+    {
+        return (valid[index] >> way) & 1;
+    }
+
+    bool isDirty(std::size_t index, int way) const
+    {
+        return (dirty[index] >> way) & 1;
+    }
+
+    void setDirty(std::size_t index, int way)
+    {
+        dirty[index] |= WayMask(WayMask(1) << way);
+    }
+
+    // install a clean block in the way
+    void fill(std::size_t index, int way, Tag tag)
+    {
+        tags[index].way[way] = tag;
+        valid[index] |= WayMask(WayMask(1) << way);
+        dirty[index] &= WayMask(~(WayMask(1) << way));
+        policy.insert(index, way);
+    }
+
+    void invalidate(std::size_t index, int way)
+    {
+        valid[index] &= WayMask(~(WayMask(1) << way));
+        dirty[index] &= WayMask(~(WayMask(1) << way));
+    }
+
+    // return the way holding the tag, or -1 on a miss. Every way of the set
+    // is compared at once, see tag_match.h.
+    int lookup(std::size_t index, Tag tag) const
+    {
+        std::uint64_t match = matchTags<Tag, Ways>(tags[index].way, tag) & valid[index];
+        return match ? lowestWay(match) : -1;
+    }
+
+    // choose the first invalid way, otherwise ask the replacement policy
+    int findVictim(std::size_t index)
+    {
+        WayMask invalid = WayMask(~valid[index] & ALL_WAYS);
+        if (invalid)
+            return lowestWay(invalid);
+        return policy.victim(index);
+    }
+
+    // record a hit on the way
+    void updateHistory(std::size_t index, int way)
+    {
+        policy.touch(index, way);
+    }
+
+    // history bit as shown by the two way display, 1 for MRU
+    bool isMRU(std::size_t index, int way) const
+    {
+        return policy.isMRU(index, way);
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(tags, valid, dirty, policy);
+    }
+
+private:
+    static int lowestWay(std::uint64_t mask)
+    {
+        return __builtin_ctzll(mask);
+    }
+
+    // structure of arrays: tags, packed state bits and replacement state
+    // are each stored contiguously and indexed by set
+    std::vector<TagRow> tags;
+    std::vector<WayMask> valid;
+    std::vector<WayMask> dirty;
+    ReplacementPolicy policy;
+};
+
+// data held by the blocks of a cache, kept apart from the tag store in one
+// contiguous arena so tag only simulations do not pay for it
+template <class CacheType>
+class LineStore
+{
+public:
+    LineStore() : words(CacheType::BLOCKS * CacheType::WORDS_PER_LINE, 0) {}
+
+    int *line(std::size_t index, int way)
+    {
+        return &words[(index * CacheType::WAYS + way) * CacheType::WORDS_PER_LINE];
+    }
+
+    const int *line(std::size_t index, int way) const
+    {
+        return &words[(index * CacheType::WAYS + way) * CacheType::WORDS_PER_LINE];
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(words);
+    }
+
+private:
+    std::vector<int> words;
+};
+
+#endif
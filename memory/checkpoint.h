@@ -0,0 +1,239 @@
+// Binary checkpoints of simulator state.
+//
+// A component that holds state has one member
+//   template <class Archive> void transfer(Archive &archive)
+// listing its fields as archive(a, b, c). The same function saves, through
+// CheckpointWriter, and restores, through CheckpointReader, so the two can
+// never disagree on the layout. Trivially copyable fields and vectors of
+// them are copied as raw bytes; other containers are written as a count
+// followed by their elements. Code that must act differently on restore,
+// such as rebuilding a hash table, tests Archive::LOADING.
+//
+// A checkpoint starts with a magic number, a format version and a shape
+// string naming the build (geometry and compiled-in models), and is only
+// read back by a build with the same shape. Integers are stored in host
+// byte order.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+const std::uint32_t CHECKPOINT_MAGIC = 0x4B435343; // "CSCK"
+const std::uint32_t CHECKPOINT_VERSION = 2;
+
+// true for types with a transfer member taking the archive
+template <class T, class Archive, class = void>
+struct HasTransfer : std::false_type
+{
+};
+
+template <class T, class Archive>
+struct HasTransfer<T, Archive, decltype(std::declval<T &>().transfer(std::declval<Archive &>()), void())> : std::true_type
+{
+};
+
+class CheckpointWriter
+{
+public:
+    static const bool LOADING = false;
+
+    CheckpointWriter(std::ostream &out, const std::string &shape) : out(out)
+    {
+        (*this)(CHECKPOINT_MAGIC, CHECKPOINT_VERSION, shape);
+    }
+
+    bool good() const { return bool(out); }
+
+    template <class... Values>
+    void operator()(const Values &...values)
+    {
+        int expand[] = {0, (item(values), 0)...};
+        (void)expand;
+    }
+
+private:
+    template <class T>
+    void item(const T &value)
+    {
+        if constexpr (HasTransfer<T, CheckpointWriter>::value)
+            const_cast<T &>(value).transfer(*this);
+        else
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "checkpointed fields need transfer or must be trivially copyable");
+            bytes(&value, sizeof(T));
+        }
+    }
+
+    template <class T>
+    void item(const std::vector<T> &values)
+    {
+        count(values.size());
+        if constexpr (std::is_trivially_copyable<T>::value && !HasTransfer<T, CheckpointWriter>::value)
+            bytes(values.data(), values.size() * sizeof(T));
+        else
+        {
+            for (const T &value : values)
+                item(value);
+        }
+    }
+
+    template <class Key, class Value>
+    void item(const std::unordered_map<Key, Value> &values)
+    {
+        count(values.size());
+        for (const auto &entry : values)
+        {
+            item(entry.first);
+            item(entry.second);
+        }
+    }
+
+    template <class Key>
+    void item(const std::unordered_set<Key> &values)
+    {
+        count(values.size());
+        for (const Key &key : values)
+            item(key);
+    }
+
+    void item(const std::string &value)
+    {
+        count(value.size());
+        bytes(value.data(), value.size());
+    }
+
+    void count(std::size_t size)
+    {
+        std::uint64_t value = size;
+        bytes(&value, sizeof(value));
+    }
+
+    void bytes(const void *data, std::size_t size)
+    {
+        out.write(static_cast<const char *>(data), std::streamsize(size));
+    }
+
+    std::ostream &out;
+};
+
+class CheckpointReader
+{
+public:
+    static const bool LOADING = true;
+
+    // check the header, good() is false if it does not match the shape
+    CheckpointReader(std::istream &in, const std::string &shape) : in(in)
+    {
+        std::uint32_t magic = 0, version = 0;
+        std::string savedShape;
+        (*this)(magic, version, savedShape);
+        if (magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION || savedShape != shape)
+            failed = true;
+    }
+
+    bool good() const { return !failed && bool(in); }
+
+    template <class... Values>
+    void operator()(Values &...values)
+    {
+        int expand[] = {0, (item(values), 0)...};
+        (void)expand;
+    }
+
+private:
+    template <class T>
+    void item(T &value)
+    {
+        if constexpr (HasTransfer<T, CheckpointReader>::value)
+            value.transfer(*this);
+        else
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "checkpointed fields need transfer or must be trivially copyable");
+            bytes(&value, sizeof(T));
+        }
+    }
+
+    template <class T>
+    void item(std::vector<T> &values)
+    {
+        values.resize(count(sizeof(T)));
+        if constexpr (std::is_trivially_copyable<T>::value && !HasTransfer<T, CheckpointReader>::value)
+            bytes(values.data(), values.size() * sizeof(T));
+        else
+        {
+            for (T &value : values)
+                item(value);
+        }
+    }
+
+    template <class Key, class Value>
+    void item(std::unordered_map<Key, Value> &values)
+    {
+        values.clear();
+        std::size_t size = count(sizeof(Key) + sizeof(Value));
+        values.reserve(size);
+        for (std::size_t i = 0; i < size && good(); ++i)
+        {
+            Key key;
+            item(key);
+            item(values[key]);
+        }
+    }
+
+    template <class Key>
+    void item(std::unordered_set<Key> &values)
+    {
+        values.clear();
+        std::size_t size = count(sizeof(Key));
+        values.reserve(size);
+        for (std::size_t i = 0; i < size && good(); ++i)
+        {
+            Key key;
+            item(key);
+            values.insert(key);
+        }
+    }
+
+    void item(std::string &value)
+    {
+        value.resize(count(1));
+        bytes(&value[0], value.size());
+    }
+
+    // a stored element count, 0 after an error or when it cannot be right
+    std::size_t count(std::size_t elementBytes)
+    {
+        std::uint64_t value = 0;
+        bytes(&value, sizeof(value));
+        // a corrupt count must not allocate without bound
+        if (!good() || value > (std::uint64_t(1) << 40) / (elementBytes ? elementBytes : 1))
+        {
+            failed = true;
+            return 0;
+        }
+        return std::size_t(value);
+    }
+
+    void bytes(void *data, std::size_t size)
+    {
+        if (failed || size == 0)
+            return;
+        if (!in.read(static_cast<char *>(data), std::streamsize(size)))
+            failed = true;
+    }
+
+    std::istream &in;
+    bool failed = false;
+};
+
+#endif
@@ -0,0 +1,318 @@
+// Private per-core caches kept coherent by a snooping bus.
+//
+// Every core has its own Cache for tags and replacement plus a coherence
+// state per block. Misses and upgrades are broadcast on the bus and every
+// other core snoops them:
+//   BusRd   read miss, an M owner supplies the line and drops to S (MESI,
+//           writing it back) or O (MOESI, keeping it dirty); E drops to S
+//   BusRdX  write miss, every other copy is invalidated, a dirty owner
+//           supplies the line
+//   BusUpgr write hit on S or O, every other copy is invalidated
+// A read miss with no other copy fills in E, so a later write needs no bus.
+//
+// Misses are classified as cold, replacement or coherence misses; a
+// coherence miss is a miss on a line this core lost to an invalidation. It
+// is true sharing when another core has since written the word being
+// accessed, and false sharing when the other cores only wrote other words
+// of the line.
+
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "cache.h"
+#include "miss_class.h"
+
+enum class Protocol
+{
+    MESI,
+    MOESI
+};
+
+inline const char *protocolName(Protocol protocol)
+{
+    return protocol == Protocol::MOESI ? "MOESI" : "MESI";
+}
+
+enum class CoherenceState : std::uint8_t
+{
+    Invalid,
+    Shared,
+    Exclusive,
+    Owned,
+    Modified
+};
+
+inline char stateLetter(CoherenceState state)
+{
+    static const char letters[] = {'I', 'S', 'E', 'O', 'M'};
+    return letters[int(state)];
+}
+
+struct CoreStats
+{
+    std::uint64_t reads = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t readHits = 0;
+    std::uint64_t writeHits = 0;
+    std::uint64_t coldMisses = 0;
+    std::uint64_t replacementMisses = 0;
+    std::uint64_t trueSharingMisses = 0;
+    std::uint64_t falseSharingMisses = 0;
+    std::uint64_t invalidationsReceived = 0;
+    std::uint64_t upgrades = 0;
+
+    std::uint64_t coherenceMisses() const { return trueSharingMisses + falseSharingMisses; }
+};
+
+struct BusStats
+{
+    std::uint64_t reads = 0;          // BusRd
+    std::uint64_t readExclusives = 0; // BusRdX
+    std::uint64_t upgrades = 0;       // BusUpgr
+    std::uint64_t invalidations = 0;  // copies invalidated
+    std::uint64_t cacheToCache = 0;   // lines supplied by a dirty owner
+    std::uint64_t writebacks = 0;     // dirty lines written to memory
+};
+
+// sharing counters of one line
+struct LineSharing
+{
+    std::uint64_t invalidations = 0;
+    std::uint64_t trueSharingMisses = 0;
+    std::uint64_t falseSharingMisses = 0;
+};
+
+template <class CacheType>
+class CoherentCaches
+{
+public:
+    using Address = std::uint64_t;
+
+    static_assert(CacheType::WORDS_PER_LINE <= 64, "written words are tracked in 64 bits");
+
+    CoherentCaches(std::size_t coreCount, Protocol protocol) : protocol(protocol), cores(coreCount) {}
+
+    std::size_t size() const { return cores.size(); }
+
+    // one load or store of a core
+    void access(std::size_t core, Address address, bool isWrite)
+    {
+        Core &self = cores[core];
+        std::uint64_t line = address >> CacheType::OFFSET_BITS;
+        std::uint64_t word = std::uint64_t(1) << CacheType::getWord(address);
+        std::size_t index = CacheType::getIndex(address);
+        int block = self.cache.lookup(index, CacheType::getTag(address));
+
+        if (!isWrite)
+        {
+            self.stats.reads++;
+            if (block != -1)
+            {
+                self.stats.readHits++;
+                self.cache.updateHistory(index, block);
+                return;
+            }
+            classifyMiss(self, line, word);
+            fill(self, index, address, snoopRead(core, line));
+            return;
+        }
+
+        self.stats.writes++;
+        if (block != -1)
+        {
+            self.stats.writeHits++;
+            self.cache.updateHistory(index, block);
+            CoherenceState &state = self.state[index * CacheType::WAYS + block];
+            if (state == CoherenceState::Shared || state == CoherenceState::Owned)
+            {
+                // other copies may exist
+                self.stats.upgrades++;
+                bus.upgrades++;
+                invalidateOthers(core, line, false);
+            }
+            state = CoherenceState::Modified;
+        }
+        else
+        {
+            classifyMiss(self, line, word);
+            bus.readExclusives++;
+            invalidateOthers(core, line, true);
+            fill(self, index, address, CoherenceState::Modified);
+        }
+        recordWrite(core, line, word);
+    }
+
+    // state of the line in a core's cache
+    CoherenceState state(std::size_t core, Address address) const
+    {
+        const Core &self = cores[core];
+        std::size_t index = CacheType::getIndex(address);
+        int block = self.cache.lookup(index, CacheType::getTag(address));
+        return block == -1 ? CoherenceState::Invalid : self.state[index * CacheType::WAYS + block];
+    }
+
+    // single writer, multiple readers: a line in M or E is in no other
+    // cache, and at most one cache owns it in O
+    bool coherent(Address address) const
+    {
+        std::size_t valid = 0, exclusive = 0, owned = 0;
+        for (std::size_t core = 0; core < cores.size(); ++core)
+        {
+            CoherenceState s = state(core, address);
+            valid += s != CoherenceState::Invalid;
+            exclusive += s == CoherenceState::Modified || s == CoherenceState::Exclusive;
+            owned += s == CoherenceState::Owned;
+        }
+        return owned <= 1 && (exclusive == 0 || (exclusive == 1 && valid == 1));
+    }
+
+    const CoreStats &coreStats(std::size_t core) const { return cores[core].stats; }
+    const BusStats &busStats() const { return bus; }
+    const std::unordered_map<std::uint64_t, LineSharing> &lineSharing() const { return lines; }
+
+private:
+    struct Core
+    {
+        Core() : state(CacheType::BLOCKS, CoherenceState::Invalid) {}
+
+        CacheType cache;
+        std::vector<CoherenceState> state;
+        FirstTouchMap touched;
+        // lines lost to an invalidation, with the words other cores have
+        // written since
+        std::unordered_map<std::uint64_t, std::uint64_t> invalidated;
+        CoreStats stats;
+    };
+
+    void classifyMiss(Core &self, std::uint64_t line, std::uint64_t word)
+    {
+        if (self.touched.touch(line))
+        {
+            self.stats.coldMisses++;
+            return;
+        }
+        auto lost = self.invalidated.find(line);
+        if (lost == self.invalidated.end())
+        {
+            self.stats.replacementMisses++;
+            return;
+        }
+        if (lost->second & word)
+        {
+            self.stats.trueSharingMisses++;
+            lines[line].trueSharingMisses++;
+        }
+        else
+        {
+            self.stats.falseSharingMisses++;
+            lines[line].falseSharingMisses++;
+        }
+        self.invalidated.erase(lost);
+    }
+
+    // BusRd from the requesting core, returning the state it fills in
+    CoherenceState snoopRead(std::size_t requester, std::uint64_t line)
+    {
+        bus.reads++;
+        bool shared = false;
+        forEachCopy(requester, line, [&](Core &, CoherenceState &state, std::size_t, int)
+                    {
+                        shared = true;
+                        if (state == CoherenceState::Modified)
+                        {
+                            bus.cacheToCache++;
+                            if (protocol == Protocol::MOESI)
+                            {
+                                state = CoherenceState::Owned;
+                            }
+                            else
+                            {
+                                bus.writebacks++;
+                                state = CoherenceState::Shared;
+                            }
+                        }
+                        else if (state == CoherenceState::Owned)
+                        {
+                            bus.cacheToCache++;
+                        }
+                        else if (state == CoherenceState::Exclusive)
+                        {
+                            state = CoherenceState::Shared;
+                        }
+                    });
+        return shared ? CoherenceState::Shared : CoherenceState::Exclusive;
+    }
+
+    // drop every other copy. On a read for ownership, takesData, a dirty
+    // copy is handed to the requester; an upgrade already holds the data.
+    void invalidateOthers(std::size_t requester, std::uint64_t line, bool takesData)
+    {
+        forEachCopy(requester, line, [&](Core &other, CoherenceState &state, std::size_t index, int block)
+                    {
+                        if (takesData && (state == CoherenceState::Modified || state == CoherenceState::Owned))
+                            bus.cacheToCache++;
+                        state = CoherenceState::Invalid;
+                        other.cache.invalidate(index, block);
+                        other.invalidated[line] = 0;
+                        other.stats.invalidationsReceived++;
+                        bus.invalidations++;
+                        lines[line].invalidations++;
+                    });
+    }
+
+    // note the written word for every core that lost the line
+    void recordWrite(std::size_t writer, std::uint64_t line, std::uint64_t word)
+    {
+        for (std::size_t core = 0; core < cores.size(); ++core)
+        {
+            if (core == writer)
+                continue;
+            auto lost = cores[core].invalidated.find(line);
+            if (lost != cores[core].invalidated.end())
+                lost->second |= word;
+        }
+    }
+
+    // visit the valid copies of the line outside the requesting core
+    template <class Visitor>
+    void forEachCopy(std::size_t requester, std::uint64_t line, Visitor visit)
+    {
+        Address address = line << CacheType::OFFSET_BITS;
+        std::size_t index = CacheType::getIndex(address);
+        typename CacheType::Tag tag = CacheType::getTag(address);
+        for (std::size_t core = 0; core < cores.size(); ++core)
+        {
+            if (core == requester)
+                continue;
+            Core &other = cores[core];
+            int block = other.cache.lookup(index, tag);
+            if (block != -1)
+                visit(other, other.state[index * CacheType::WAYS + block], index, block);
+        }
+    }
+
+    // install the line, writing back a dirty victim
+    void fill(Core &self, std::size_t index, Address address, CoherenceState state)
+    {
+        int block = self.cache.findVictim(index);
+        if (self.cache.isValid(index, block))
+        {
+            CoherenceState victim = self.state[index * CacheType::WAYS + block];
+            if (victim == CoherenceState::Modified || victim == CoherenceState::Owned)
+                bus.writebacks++;
+        }
+        self.cache.fill(index, block, CacheType::getTag(address));
+        self.state[index * CacheType::WAYS + block] = state;
+    }
+
+    Protocol protocol;
+    std::vector<Core> cores;
+    BusStats bus;
+    std::unordered_map<std::uint64_t, LineSharing> lines;
+};
+
+#endif
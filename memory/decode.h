@@ -0,0 +1,213 @@
+// Instruction decoding into compact access records.
+//
+// decodeAscii turns text lines of 32 '0'/'1' characters into instruction
+// words, one SIMD compare and movemask per line when the host has AVX2 or
+// SSSE3 (picked at run time), and decodeWords turns a block of instruction
+// words into Access records with shifts and masks only.
+
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DECODE_X86 1
+#include <immintrin.h>
+#endif
+
+// instruction fields used by the load and store traces
+const unsigned OPCODE_LW = 35;
+const unsigned OPCODE_SW = 43;
+
+inline unsigned getOpcode(std::uint32_t instruction)
+{
+    return instruction >> 26;
+}
+
+inline unsigned getRt(std::uint32_t instruction)
+{
+    return (instruction >> 16) & 0x1F;
+}
+
+inline std::uint32_t getImmediate(std::uint32_t instruction)
+{
+    return instruction & 0xFFFF;
+}
+
+// Markers in a trace are sll $0, $0, code, a no-op, with the code in the
+// shift amount field
+enum class TraceMarker
+{
+    None,
+    WarmupEnd = 24, // statistics start over
+    RoiBegin = 25,  // statistics start over for the region of interest
+    RoiEnd = 26     // the region, and the run, end
+};
+
+inline std::uint32_t markerWord(TraceMarker marker)
+{
+    return std::uint32_t(marker) << 6;
+}
+
+inline TraceMarker getMarker(std::uint32_t instruction)
+{
+    unsigned code = (instruction >> 6) & 0x1F;
+    if ((instruction & ~std::uint32_t(0x1F << 6)) != 0 || code < 24 || code > 26)
+        return TraceMarker::None;
+    return TraceMarker(code);
+}
+
+inline const char *markerName(TraceMarker marker)
+{
+    switch (marker)
+    {
+    case TraceMarker::WarmupEnd:
+        return "warmup end";
+    case TraceMarker::RoiBegin:
+        return "roi begin";
+    case TraceMarker::RoiEnd:
+        return "roi end";
+    default:
+        return "none";
+    }
+}
+
+// decoded memory reference
+struct Access
+{
+    std::uint64_t address; // byte address
+    std::uint8_t isWrite;  // 1 for sw, 0 for lw
+    std::uint8_t reg;      // rt register
+};
+
+// decode words until the first one that is not lw or sw, returning how many
+// records were written
+inline std::size_t decodeWords(const std::uint32_t *words, std::size_t count, Access *records)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::uint32_t word = words[i];
+        unsigned opcode = getOpcode(word);
+        if (opcode != OPCODE_LW && opcode != OPCODE_SW)
+            return i;
+        records[i].address = getImmediate(word);
+        records[i].isWrite = opcode == OPCODE_SW;
+        records[i].reg = std::uint8_t(getRt(word));
+    }
+    return count;
+}
+
+// parse one 32 character line of '0' and '1', most significant bit first
+inline std::uint32_t parseInstruction(const char *line)
+{
+    std::uint32_t instruction = 0;
+    for (int i = 0; i < 32; i++)
+        instruction = (instruction << 1) | std::uint32_t(line[i] == '1');
+    return instruction;
+}
+
+#ifdef DECODE_X86
+// char i of the line is bit 31 - i: compare, reverse the bytes, movemask
+__attribute__((target("avx2"))) inline std::uint32_t parseInstructionAVX2(const char *line)
+{
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i chars = _mm256_loadu_si256((const __m256i *)line);
+    __m256i ones = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('1'));
+    ones = _mm256_shuffle_epi8(ones, reverse);
+    ones = _mm256_permute2x128_si256(ones, ones, 1);
+    return std::uint32_t(_mm256_movemask_epi8(ones));
+}
+
+__attribute__((target("ssse3"))) inline std::uint32_t parseInstructionSSSE3(const char *line)
+{
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i one = _mm_set1_epi8('1');
+    __m128i high = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)line), one);
+    __m128i low = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(line + 16)), one);
+    std::uint32_t highBits = std::uint32_t(_mm_movemask_epi8(_mm_shuffle_epi8(high, reverse)));
+    std::uint32_t lowBits = std::uint32_t(_mm_movemask_epi8(_mm_shuffle_epi8(low, reverse)));
+    return (highBits << 16) | lowBits;
+}
+#endif
+
+enum class DecodePath
+{
+    Scalar,
+    SSSE3,
+    AVX2
+};
+
+// widest path the host supports, checked once
+inline DecodePath bestDecodePath()
+{
+#ifdef DECODE_X86
+    static const DecodePath best = __builtin_cpu_supports("avx2")    ? DecodePath::AVX2
+                                   : __builtin_cpu_supports("ssse3") ? DecodePath::SSSE3
+                                                                     : DecodePath::Scalar;
+    return best;
+#else
+    return DecodePath::Scalar;
+#endif
+}
+
+template <DecodePath Path>
+std::size_t decodeAsciiWith(const char *&cursor, const char *end, std::uint32_t *words, std::size_t max)
+{
+    std::size_t count = 0;
+    while (count < max && cursor < end)
+    {
+        // skip blank lines and line endings
+        char c = *cursor;
+        if (c == '\n' || c == '\r' || c == ' ' || c == '\t')
+        {
+            cursor++;
+            continue;
+        }
+
+        const char *line = cursor;
+        const char *lineEnd = line;
+        while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r')
+            lineEnd++;
+
+        if (lineEnd - line >= 32)
+        {
+#ifdef DECODE_X86
+            if (Path == DecodePath::AVX2)
+                words[count++] = parseInstructionAVX2(line);
+            else if (Path == DecodePath::SSSE3)
+                words[count++] = parseInstructionSSSE3(line);
+            else
+#endif
+                words[count++] = parseInstruction(line);
+        }
+        else
+        {
+            // short line, missing bits read as zero
+            std::uint32_t instruction = 0;
+            for (int i = 0; i < 32; i++)
+                instruction = (instruction << 1) | std::uint32_t(line + i < lineEnd && line[i] == '1');
+            words[count++] = instruction;
+        }
+        cursor = lineEnd;
+    }
+    return count;
+}
+
+// decode up to max lines starting at cursor, which is moved past them
+inline std::size_t decodeAscii(const char *&cursor, const char *end, std::uint32_t *words, std::size_t max,
+                               DecodePath path = bestDecodePath())
+{
+    switch (path)
+    {
+    case DecodePath::AVX2:
+        return decodeAsciiWith<DecodePath::AVX2>(cursor, end, words, max);
+    case DecodePath::SSSE3:
+        return decodeAsciiWith<DecodePath::SSSE3>(cursor, end, words, max);
+    default:
+        return decodeAsciiWith<DecodePath::Scalar>(cursor, end, words, max);
+    }
+}
+
+#endif
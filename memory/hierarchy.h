@@ -0,0 +1,329 @@
+// Multi-level cache hierarchy.
+//
+// A hierarchy is a chain of Level objects ending in MainMemory, each level
+// wrapping one Cache type, so a miss in one level becomes a lookup in the
+// next. Hierarchy<L2, LLC> builds the chain from a list of cache types.
+//
+// The inclusion mode of a level describes it relative to the levels above:
+//   NINE       non-inclusive non-exclusive, fills on a miss and never
+//              invalidates the levels above
+//   Inclusive  fills on a miss and back-invalidates its victims above
+//   Exclusive  only holds lines evicted from above, a hit hands the line up
+//              and drops it here
+//
+// Levels only track tags and state. Data stays in the functional model of
+// the caller, which must honor the back-invalidations reported to it.
+
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "cache.h"
+
+enum class Inclusion
+{
+    NINE,
+    Inclusive,
+    Exclusive
+};
+
+inline const char *inclusionName(Inclusion inclusion)
+{
+    switch (inclusion)
+    {
+    case Inclusion::Inclusive:
+        return "inclusive";
+    case Inclusion::Exclusive:
+        return "exclusive";
+    default:
+        return "nine";
+    }
+}
+
+// counters of one level
+struct LevelStats
+{
+    std::uint64_t reads = 0;
+    std::uint64_t readHits = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t writeHits = 0;
+    std::uint64_t writebacksIn = 0;      // dirty lines received from above
+    std::uint64_t evictions = 0;
+    std::uint64_t dirtyEvictions = 0;
+    std::uint64_t backInvalidations = 0; // lines invalidated above this level
+};
+
+// lines evicted by inclusive levels during one access, which every level
+// above must invalidate. Each entry is a whole line of the level that
+// evicted it, so the line size ratio between levels does not add entries.
+// Only a fill on a read miss in an inclusive level adds one, and a read
+// fills each level at most once; evictions passed down only fill exclusive
+// levels, which add nothing. An access therefore adds at most one entry per
+// level, and Level checks that its chain fits.
+struct BackInvalidations
+{
+    static const int MAX_LINES = 8;
+
+    std::uint64_t address[MAX_LINES];
+    std::size_t bytes[MAX_LINES];
+    int count = 0;
+
+    void add(std::uint64_t lineAddress, std::size_t lineBytes)
+    {
+        address[count] = lineAddress;
+        bytes[count] = lineBytes;
+        count++;
+    }
+};
+
+// end of the chain, every request hits
+class MainMemory
+{
+public:
+    static const std::size_t LEVELS = 0;
+
+    bool read(std::uint64_t, BackInvalidations &, bool &dirty, std::size_t *servedBy = nullptr)
+    {
+        stats.reads++;
+        stats.readHits++;
+        dirty = false;
+        if (servedBy)
+            *servedBy = LEVELS;
+        return true;
+    }
+
+    void write(std::uint64_t, BackInvalidations &)
+    {
+        stats.writes++;
+        stats.writeHits++;
+    }
+
+    void evicted(std::uint64_t, bool dirty, BackInvalidations &)
+    {
+        if (dirty)
+            stats.writebacksIn++;
+    }
+
+    template <class Visitor>
+    void forEachLevel(Visitor visit) const
+    {
+        visit("memory", Inclusion::NINE, stats);
+    }
+
+    void resetCounters() { stats = LevelStats(); }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(stats);
+    }
+
+    LevelStats stats;
+};
+
+template <class CacheType, class Next>
+class Level
+{
+public:
+    using Address = std::uint64_t;
+
+    static const std::size_t LEVELS = Next::LEVELS + 1;
+    static_assert(LEVELS <= std::size_t(BackInvalidations::MAX_LINES), "an access could back-invalidate more lines than are tracked");
+
+    Next &next() { return lower; }
+    const Next &next() const { return lower; }
+
+    void configure(const std::string &levelName, Inclusion levelInclusion)
+    {
+        name = levelName;
+        inclusion = levelInclusion;
+    }
+
+    // demand read from above, true on a hit in this level. dirty is set when
+    // an exclusive level hands a modified line up, and servedBy to the LEVELS
+    // of the level that held the line, 0 for memory.
+    bool read(Address address, BackInvalidations &invalidations, bool &dirty, std::size_t *servedBy = nullptr)
+    {
+        std::size_t index = CacheType::getIndex(address);
+        int block = cache.lookup(index, CacheType::getTag(address));
+        stats.reads++;
+        dirty = false;
+
+        if (block != -1)
+        {
+            stats.readHits++;
+            if (servedBy)
+                *servedBy = LEVELS;
+            if (inclusion == Inclusion::Exclusive)
+            {
+                // the line moves up
+                dirty = cache.isDirty(index, block);
+                cache.invalidate(index, block);
+            }
+            else
+            {
+                cache.updateHistory(index, block);
+            }
+            return true;
+        }
+
+        bool dirtyBelow = false;
+        lower.read(address, invalidations, dirtyBelow, servedBy);
+        applyInvalidations(invalidations);
+
+        if (inclusion == Inclusion::Exclusive)
+        {
+            // only victims from above are allocated here
+            dirty = dirtyBelow;
+            return false;
+        }
+
+        block = allocate(index, CacheType::getTag(address), invalidations);
+        if (dirtyBelow)
+            cache.setDirty(index, block);
+        return false;
+    }
+
+    // write that was not absorbed above, updates the line if it is here
+    void write(Address address, BackInvalidations &invalidations)
+    {
+        std::size_t index = CacheType::getIndex(address);
+        int block = cache.lookup(index, CacheType::getTag(address));
+        stats.writes++;
+        if (block != -1)
+        {
+            stats.writeHits++;
+            cache.updateHistory(index, block);
+            cache.setDirty(index, block);
+            return;
+        }
+        lower.write(address, invalidations);
+        applyInvalidations(invalidations);
+    }
+
+    // a line left the level above
+    void evicted(Address address, bool dirty, BackInvalidations &invalidations)
+    {
+        if (dirty)
+            stats.writebacksIn++;
+
+        std::size_t index = CacheType::getIndex(address);
+        typename CacheType::Tag tag = CacheType::getTag(address);
+        int block = cache.lookup(index, tag);
+        if (block != -1)
+        {
+            if (dirty)
+                cache.setDirty(index, block);
+            return;
+        }
+
+        if (inclusion == Inclusion::Exclusive)
+        {
+            block = allocate(index, tag, invalidations);
+            if (dirty)
+                cache.setDirty(index, block);
+        }
+        else if (dirty)
+        {
+            lower.evicted(address, true, invalidations);
+        }
+    }
+
+    template <class Visitor>
+    void forEachLevel(Visitor visit) const
+    {
+        visit(name.c_str(), inclusion, stats);
+        lower.forEachLevel(visit);
+    }
+
+    // zero the statistics of this level and the ones below
+    void resetCounters()
+    {
+        stats = LevelStats();
+        lower.resetCounters();
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(cache, stats, lower, name, inclusion);
+    }
+
+    CacheType cache;
+    LevelStats stats;
+
+private:
+    // fill a way for the tag, sending the victim down
+    int allocate(std::size_t index, typename CacheType::Tag tag, BackInvalidations &invalidations)
+    {
+        int block = cache.findVictim(index);
+        if (cache.isValid(index, block))
+        {
+            Address victim = CacheType::getBlockAddress(index, cache.getTag(index, block));
+            bool dirty = cache.isDirty(index, block);
+            stats.evictions++;
+            if (dirty)
+                stats.dirtyEvictions++;
+            if (inclusion == Inclusion::Inclusive)
+            {
+                stats.backInvalidations++;
+                invalidations.add(victim, CacheType::LINE_BYTES);
+            }
+            lower.evicted(victim, dirty, invalidations);
+        }
+        cache.fill(index, block, tag);
+        return block;
+    }
+
+    // drop the lines an inclusive level below has evicted
+    void applyInvalidations(BackInvalidations &invalidations)
+    {
+        for (int i = 0; i < invalidations.count; ++i)
+        {
+            for (std::size_t offset = 0; offset < invalidations.bytes[i]; offset += CacheType::LINE_BYTES)
+            {
+                Address address = invalidations.address[i] + offset;
+                std::size_t index = CacheType::getIndex(address);
+                int block = cache.lookup(index, CacheType::getTag(address));
+                if (block == -1)
+                    continue;
+                bool dirty = cache.isDirty(index, block);
+                cache.invalidate(index, block);
+                if (dirty)
+                {
+                    stats.dirtyEvictions++;
+                    lower.evicted(address, true, invalidations);
+                }
+            }
+        }
+    }
+
+    Next lower;
+    std::string name = "cache";
+    Inclusion inclusion = Inclusion::NINE;
+};
+
+// Hierarchy<C1, C2, ...> is Level<C1, Level<C2, ... MainMemory>>
+template <class... CacheTypes>
+struct HierarchyOf;
+
+template <>
+struct HierarchyOf<>
+{
+    using type = MainMemory;
+};
+
+template <class CacheType, class... Rest>
+struct HierarchyOf<CacheType, Rest...>
+{
+    using type = Level<CacheType, typename HierarchyOf<Rest...>::type>;
+};
+
+template <class... CacheTypes>
+using Hierarchy = typename HierarchyOf<CacheTypes...>::type;
+
+#endif
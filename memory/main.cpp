@@ -10,201 +10,412 @@
 #include <vector>
 #include <fstream>
 #include <string>
+#include "pipeline.h"
+#include "simulator.h"
+#include "trace.h"
 
 using namespace std;
 
-// cache block structure
-struct CacheBlock
-{
-    bool valid = 0; // 0 for cold start, 1 for valid
-    bool history;   // 1 MRU, 0 LRU
-    bitset<4> tag;
-    int data;
-};
-
-// cache size, memory size, instruction bits, cache associativity
-const int CACHE_SIZE = 16;
-const int CACHE_ASSOC = 2;
+// bytes per block, one word unless built with -DL1_LINE_BYTES=16 to 128.
+// One word blocks use 9 bit byte addresses, giving a 4 bit tag, wider
+// blocks use the whole 16 bit immediate. --tlb needs the page tables in
+// the cached address space, so it is refused unless -DL1_ADDR_BITS=32 or
+// wider gives them room.
+#ifndef L1_LINE_BYTES
+#define L1_LINE_BYTES 4
+#endif
+#ifndef L1_ADDR_BITS
+#define L1_ADDR_BITS (L1_LINE_BYTES == 4 ? 9 : 16)
+#endif
+
+// the assignment's 16 block 2-way cache over the narrow addresses above;
+// a record past them is an error
+using ReplaySimulator = BasicCacheSimulator<Cache<8, 2, L1_LINE_BYTES, L1_ADDR_BITS>>;
+
+// memory words shown by displayMemory
 const int MEM_SIZE = 128;
 
-// register file
-int registers[8] = {0};
+// quiet mode skips the per access output and the displays
+bool quiet = false;
 
-// cache structure
-vector<vector<CacheBlock>> cache(CACHE_SIZE / CACHE_ASSOC, vector<CacheBlock>(CACHE_ASSOC));
+// instructions of the trace consumed so far, the count a restored
+// checkpoint resumes after and the count to stop after
+uint64_t position = 0;
+uint64_t resumeAt = 0;
+uint64_t stopAt = ~uint64_t(0);
 
-// main memory
-int memory[MEM_SIZE];
+// statistics rows every interval instructions when not 0, and whether
+// warmup and region markers in the trace are acted on
+uint64_t interval = 0;
+IntervalLog *intervals = nullptr;
+bool useMarkers = true;
 
 // fetch and decode instructions
-void fetchInstructions();
-void decodeInstruction(bitset<32> instruction);
-
-// execute load word instruction
-void execLoadWord(bitset<5> rt, bitset<16> immediate);
-void lwMiss(int index, bitset<5> rt, bitset<16> immediate);
-
-// execute store word instruction
-void execStoreWord(bitset<5> rt, bitset<16> immediate);
-
-// find least recently used block, and write back address
-int findLRUBlock(int index);
-int findWBAddress(int index, int block);
-void updateHistoryBits(int index, int block);
+void fetchInstructions(ReplaySimulator &sim, string fileName);
+bool executeBatch(ReplaySimulator &sim, const TraceBatch &batch);
+void executeRecords(ReplaySimulator &sim, const uint32_t *words, const Access *records, size_t count);
+bool executeMarker(ReplaySimulator &sim, uint32_t word);
+bool decodeInstruction(bitset<32> instruction, Access &access);
+bool verifyDecode(string fileName);
 
 // helper functions
-int getAddress(bitset<16> immediate);
-int getIndex(bitset<16> immediate);
-bitset<4> getTag(bitset<16> immediate);
 bitset<32> stringToBitset(string line);
-
-// initialization and display functions
-void initializeMemory();
-void initializeRegisters();
-void displayCache();
-void displayMemory();
-void displayRegisters();
 bool PRINT_ZEROES = 1;
 
-int main()
-{
-    initializeMemory();
-    initializeRegisters();
-    cout << endl;
-
-    // fetch, decode, then execute instructions
-    fetchInstructions();
-
-    // display registers, cache, and memory
-    displayRegisters();
-    displayCache();
-    displayMemory();
-
-    return 0;
-}
-
-// execute store word instruction
-void execStoreWord(bitset<5> rt, bitset<16> immediate)
+int main(int argc, char *argv[])
 {
-    int index = getIndex(immediate);
-    bitset<4> tag = getTag(immediate);
-
-    bool cacheHit = false;
-    int block = -1;
-
-    // Check if the data is in the cache
-    for (int i = 0; i < CACHE_ASSOC; ++i)
+    // text or binary trace, input_file.txt by default
+    string fileName = "input_file.txt";
+    string statsFormat;
+    bool dumpEvents = false;
+    bool showTiming = false;
+    string checkpointFile, restoreFile, intervalFile;
+    SimulatorConfig config;
+    // the trace's addresses are 16 bit immediates, so the page tables go
+    // just above them rather than at the top of the address space
+    config.mmu.tableBase = uint64_t(1) << 16;
+
+    for (int i = 1; i < argc; ++i)
     {
-        if (cache[index][i].valid && cache[index][i].tag == tag)
+        string arg = argv[i];
+        if ((arg == "--l2" || arg == "--llc") && i + 1 < argc)
         {
-            cacheHit = true;
-            block = i;
-            break;
+            // --l2 and --llc take nine, inclusive or exclusive
+            string mode = argv[++i];
+            Inclusion inclusion;
+            if (mode == "nine")
+                inclusion = Inclusion::NINE;
+            else if (mode == "inclusive")
+                inclusion = Inclusion::Inclusive;
+            else if (mode == "exclusive")
+                inclusion = Inclusion::Exclusive;
+            else
+            {
+                cerr << "Unknown inclusion mode " << mode << endl;
+                return 1;
+            }
+            if (arg == "--l2")
+                config.l2Inclusion = inclusion;
+            else
+                config.l3Inclusion = inclusion;
+            config.useHierarchy = true;
+        }
+        else if (arg == "-q" || arg == "--quiet")
+            quiet = true;
+        else if (arg == "--stats" && i + 1 < argc)
+            statsFormat = argv[++i]; // json or csv
+        else if (arg == "--events")
+            dumpEvents = true;
+        else if (arg == "--classify")
+            config.classifyMisses = Stats::ENABLED;
+        else if (arg == "--write" && i + 1 < argc)
+        {
+            // back or through
+            string mode = argv[++i];
+            if (mode == "back")
+                config.writePolicy = WritePolicy::WriteBack;
+            else if (mode == "through")
+                config.writePolicy = WritePolicy::WriteThrough;
+            else
+            {
+                cerr << "Unknown write policy " << mode << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--write-miss" && i + 1 < argc)
+        {
+            // allocate or no-allocate
+            string mode = argv[++i];
+            if (mode == "allocate")
+                config.writeMiss = WriteMiss::Allocate;
+            else if (mode == "no-allocate")
+                config.writeMiss = WriteMiss::NoAllocate;
+            else
+            {
+                cerr << "Unknown write miss policy " << mode << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--write-buffer" && i + 1 < argc)
+            config.writeBufferEntries = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--prefetch" && i + 1 < argc)
+        {
+            // none, next-line, stride or stream
+            string kind = argv[++i];
+            if (kind == "none")
+                config.prefetchKind = PrefetchKind::None;
+            else if (kind == "next-line")
+                config.prefetchKind = PrefetchKind::NextLine;
+            else if (kind == "stride")
+                config.prefetchKind = PrefetchKind::Stride;
+            else if (kind == "stream")
+                config.prefetchKind = PrefetchKind::Stream;
+            else
+            {
+                cerr << "Unknown prefetcher " << kind << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--prefetch-degree" && i + 1 < argc)
+        {
+            // lines per trigger, at most what one access can propose
+            config.prefetchDegree = strtoul(argv[++i], nullptr, 10);
+            if (config.prefetchDegree > unsigned(PrefetchRequests::MAX_LINES))
+            {
+                cerr << "Prefetch degree must be at most " << PrefetchRequests::MAX_LINES << endl;
+                return 1;
+            }
         }
+        else if (arg == "--prefetch-buffer" && i + 1 < argc)
+            config.prefetchBufferEntries = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--prefetch-latency" && i + 1 < argc)
+            config.prefetchLatency = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--latency" && i + 1 < argc)
+        {
+            // L1,L2,LLC,memory in cycles
+            string list = argv[++i];
+            size_t start = 0;
+            for (int level = 0; level < 4 && start <= list.size(); ++level)
+            {
+                size_t comma = list.find(',', start);
+                config.levelLatency[level] = strtoul(list.substr(start, comma - start).c_str(), nullptr, 10);
+                start = comma == string::npos ? list.size() + 1 : comma + 1;
+            }
+            showTiming = true;
+        }
+        else if (arg == "--mshrs" && i + 1 < argc)
+        {
+            config.mshrs = strtoul(argv[++i], nullptr, 10);
+            showTiming = true;
+        }
+        else if (arg == "--tlb")
+            config.useTLB = true;
+        else if (arg == "--page-size" && i + 1 < argc)
+        {
+            // 4k, 2m or 1g
+            string size = argv[++i];
+            config.mmu.pageSize = size == "1g" ? PageSize::Huge : size == "2m" ? PageSize::Large : PageSize::Small;
+            config.useTLB = true;
+        }
+        else if ((arg == "--dtlb" || arg == "--stlb") && i + 1 < argc)
+        {
+            // entries,ways
+            TlbConfig &tlb = arg == "--dtlb" ? config.mmu.l1 : config.mmu.l2;
+            char *end = nullptr;
+            tlb.entries = strtoul(argv[++i], &end, 10);
+            if (*end == ',')
+                tlb.ways = strtoul(end + 1, nullptr, 10);
+            config.useTLB = true;
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            checkpointFile = argv[++i]; // saved at the end or at --stop-after
+        else if (arg == "--restore" && i + 1 < argc)
+            restoreFile = argv[++i];
+        else if (arg == "--stop-after" && i + 1 < argc)
+            stopAt = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--interval" && i + 1 < argc)
+            interval = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--interval-out" && i + 1 < argc)
+            intervalFile = argv[++i]; // standard output by default
+        else if (arg == "--no-markers")
+            useMarkers = false;
+        else if (arg == "--verify-decode")
+            return verifyDecode(i + 1 < argc ? argv[i + 1] : fileName) ? 0 : 1;
+        else
+            fileName = arg;
     }
+    if (!quiet)
+        config.log = &cout;
 
-    if (cacheHit)
+    ReplaySimulator sim(config);
+    if (!restoreFile.empty())
     {
-        // update history bits, and write to cache
-        cout << "sw hit" << endl;
-        updateHistoryBits(index, block);
-        cache[index][block].data = registers[rt.to_ulong() - 16];
+        // the checkpoint brings its own configuration
+        ifstream in(restoreFile, ios::binary);
+        if (!sim.restore(in, resumeAt))
+        {
+            cerr << "Unable to restore " << restoreFile << endl;
+            return 1;
+        }
     }
-    else
+    if (sim.getConfig().useTLB && !ReplaySimulator::tablesInRange(sim.getConfig().mmu))
     {
-        // write directly to memory
-        cout << "sw miss" << endl;
-        int address = getAddress(immediate);
-        memory[address] = registers[(rt.to_ulong() - 16)];
+        // walks would bypass the caches they are meant to go through
+        cerr << "Page tables do not fit in the " << ReplaySimulator::ADDR_BITS
+             << " bit address space, build with -DL1_ADDR_BITS=32 to use the TLB" << endl;
+        return 1;
     }
-    return;
-}
-
-// execute load word instruction
-void execLoadWord(bitset<5> rt, bitset<16> immediate)
-{
-    int index = getIndex(immediate);
-    bitset<4> tag = getTag(immediate);
-
-    bool cacheHit = false;
-    int block = -1;
-
-    // Check if the data is in the cache
-    for (int i = 0; i < CACHE_ASSOC; ++i)
+    if (stopAt < resumeAt)
     {
-        if (cache[index][i].valid && cache[index][i].tag == tag)
-        {
-            cacheHit = true;
-            block = i;
-            break;
-        }
+        // --stop-after counts from the start of the trace, not the checkpoint
+        cerr << "Stop point " << stopAt << " is before the checkpoint at " << resumeAt << endl;
+        return 1;
     }
+    if (!quiet)
+        cout << endl;
 
-    if (cacheHit)
+    // the time series goes out as the run goes
+    ofstream intervalOut;
+    if (!intervalFile.empty())
+        intervalOut.open(intervalFile);
+    IntervalLog intervalLog(intervalFile.empty() ? cout : intervalOut);
+    if (interval)
     {
-        // update history bits, and write to register
-        cout << "lw hit" << endl;
-        updateHistoryBits(index, block);
-        registers[rt.to_ulong() - 16] = cache[index][block].data;
+        intervals = &intervalLog;
+        intervals->writeHeader();
+        intervals->rebase(sim.statistics(), resumeAt);
     }
-    else
+
+    // fetch, decode, then execute instructions
+    fetchInstructions(sim, fileName);
+    if (intervals && position > intervals->lastRow())
+        intervals->row(sim.statistics(), position, "end");
+    if (!checkpointFile.empty())
     {
-        cout << "lw miss" << endl;
-        lwMiss(index, rt, immediate);
+        // taken before the final flush so a resumed run continues exactly
+        ofstream out(checkpointFile, ios::binary);
+        if (!sim.save(out, position))
+        {
+            cerr << "Unable to write " << checkpointFile << endl;
+            return 1;
+        }
     }
-}
-
-// read miss
-void lwMiss(int index, bitset<5> rt, bitset<16> immediate)
-{
-    // select the victim block, and set history bits
-    int block = findLRUBlock(index);
-    updateHistoryBits(index, block);
+    sim.flush();
 
-    // if the block is valid, write back to memory
-    if (cache[index][block].valid == 1)
+    // display registers, cache, and memory, or only the summary when quiet
+    if (!quiet)
     {
-        int writeBackAddress = findWBAddress(index, block);
-        memory[writeBackAddress] = cache[index][block].data;
+        sim.displayRegisters(cout);
+        sim.displayCache(cout, PRINT_ZEROES);
+        sim.displayMemory(cout, MEM_SIZE);
+        if (sim.getConfig().useHierarchy)
+            sim.displayHierarchy(cout);
+        if (showTiming && Timing::ENABLED)
+            sim.displayTiming(cout);
+        if (sim.getConfig().useTLB)
+            sim.displayTLB(cout);
     }
+    else if (statsFormat.empty())
+        statsFormat = "json";
 
-    // set cache data, tag, and valid bit
-    int address = getAddress(immediate);
-    cache[index][block].data = memory[address];
-    cache[index][block].tag = getTag(immediate);
-    cache[index][block].valid = true;
+    if (statsFormat == "json")
+        sim.writeJSON(cout);
+    else if (statsFormat == "csv")
+        sim.writeCSV(cout);
+    if (dumpEvents)
+        sim.events().dump(cout);
 
-    // read from cache to register
-    registers[rt.to_ulong() - 16] = cache[index][block].data;
+    return 0;
 }
 
 // read instrctions from file
-void fetchInstructions()
+void fetchInstructions(ReplaySimulator &sim, string fileName)
 {
-    ifstream inputFile("input_file.txt");
-
-    if (!inputFile.is_open())
+    // a reader thread reads and decodes the trace while this one simulates;
+    // binary traces start at a restored checkpoint's record directly
+    TraceReader reader;
+    if (!reader.open(fileName, resumeAt))
     {
         cerr << "Unable to open file" << endl;
     }
+    position = reader.startPosition();
+    while (TraceBatch *batch = reader.nextBatch())
+    {
+        bool more = executeBatch(sim, *batch);
+        reader.release(batch);
+        if (!more)
+            break;
+    }
+    if (!quiet)
+        cout << endl;
+}
 
-    bitset<32> instruction;
-    string line;
+// execute a batch of decoded records and the word that ended it.
+// False once the run reaches stopAt or the end of the region of interest.
+bool executeBatch(ReplaySimulator &sim, const TraceBatch &batch)
+{
+    // skip what the restored checkpoint already ran, and stop at stopAt
+    size_t first = size_t(min<uint64_t>(resumeAt > position ? resumeAt - position : 0, batch.size()));
+    position += first;
+    size_t last = batch.size();
+    bool more = last - first < stopAt - position;
+    if (!more)
+        last = first + size_t(stopAt - position);
+
+    if (first < min(last, batch.count))
+        executeRecords(sim, batch.words + first, batch.records + first, min(last, batch.count) - first);
+    if (last <= batch.count || first > batch.count)
+        return more;
+
+    // only load word, store word and markers are supported
+    if (!quiet)
+        cout << bitset<32>(batch.stop) << " \t";
+    if (getMarker(batch.stop) == TraceMarker::None)
+    {
+        cout << "error" << endl;
+        exit(1);
+    }
+    position++;
+    return executeMarker(sim, batch.stop) && more;
+}
 
-    // read instruction from file
-    int count = 0;
-    while (getline(inputFile, line))
+// run decoded records, writing an interval row at every multiple of interval
+void executeRecords(ReplaySimulator &sim, const uint32_t *words, const Access *records, size_t count)
+{
+    for (size_t done = 0; done < count;)
     {
-        instruction = stringToBitset(line);
-        cout << instruction << " \t";
-        decodeInstruction(instruction);
+        size_t run = count - done;
+        if (interval && run > interval - position % interval)
+            run = size_t(interval - position % interval);
+
+        size_t ran = run;
+        if (quiet)
+            ran = sim.access(records + done, run);
+        else
+        {
+            for (size_t i = done; i < done + run && ran == run; ++i)
+            {
+                cout << bitset<32>(words[i]) << " \t";
+                if (!sim.execute(records[i]))
+                    ran = i - done;
+            }
+        }
+        if (ran < run)
+        {
+            // the address is past the simulated address space
+            cout << "error" << endl;
+            exit(1);
+        }
+        done += run;
+        position += run;
+        if (interval && position % interval == 0)
+            intervals->row(sim.statistics(), position);
     }
-    cout << endl;
-    inputFile.close();
 }
 
-// decode the instruction and then execute store word or load word
-void decodeInstruction(bitset<32> instruction)
+// act on a trace marker, false when the run ends at it
+bool executeMarker(ReplaySimulator &sim, uint32_t word)
+{
+    TraceMarker marker = getMarker(word);
+    if (!quiet)
+        cout << markerName(marker) << endl;
+    if (!useMarkers)
+        return true;
+
+    // the row of the references before the marker, then counters from zero
+    if (intervals)
+        intervals->row(sim.statistics(), position, markerName(marker));
+    if (marker == TraceMarker::RoiEnd)
+        return false;
+    sim.resetStatistics();
+    if (intervals)
+        intervals->rebase(sim.statistics(), position);
+    return true;
+}
+
+// decode one instruction bit by bit, false if it is not a load or store.
+// Kept as the reference for the batch decoder.
+bool decodeInstruction(bitset<32> instruction, Access &access)
 {
     // NOTE: rs (bits 21-25) is assumed to be zero for simplicity.
     bitset<6> opcode; // bits 26-31
@@ -224,111 +435,60 @@ void decodeInstruction(bitset<32> instruction)
     }
 
     // '100011' for load and '101011' for store
-    if (opcode == 35)
-        execLoadWord(rt, immediate);
-    else if (opcode == 43)
-        execStoreWord(rt, immediate);
-    else
-    {
-        cout << "error" << endl;
-        exit(1);
-    }
+    if (opcode != 35 && opcode != 43)
+        return false;
+    access.address = immediate.to_ulong();
+    access.isWrite = opcode == 43;
+    access.reg = uint8_t(rt.to_ulong());
+    return true;
 }
 
-// return index from immediate value, bits 2-5
-int getIndex(bitset<16> immediate)
+// check every batch decode path the host supports against the bit by bit
+// decoder, up to the first instruction that is not a load or store
+bool verifyDecode(string fileName)
 {
-    bitset<4> index("000");
-    for (int i = 2; i < 6; i++)
-        index[i - 2] = immediate[i];
-    index[3] = 0;
-
-    return index.to_ulong();
-}
-
-// return tag from immediate value, bits 6-9
-bitset<4> getTag(bitset<16> immediate)
-{
-    bitset<4> tag;
-    for (int i = 5; i < 9; i++)
-        tag[i - 5] = immediate[i];
-    return tag;
-}
-
-// converts the immediate byte address to a word address
-int getAddress(bitset<16> immediate)
-{
-    bitset<14> address;
-    for (int i = 2; i < 16; i++)
-        address[i - 2] = immediate[i];
-    return address.to_ulong();
-}
-
-void displayMemory()
-{
-    cout << "Addr\tData" << endl;
-    for (int i = 0; i < MEM_SIZE; ++i)
+    ifstream inputFile(fileName);
+    MappedFile text;
+    if (!inputFile.is_open() || !text.open(fileName))
     {
-        bitset<32> mem(memory[i]);
-        cout << i << ":\t" << mem << endl;
+        cerr << "Unable to open file" << endl;
+        return false;
     }
-    cout << endl;
-}
 
-void initializeMemory()
-{
-    for (int i = 0; i < MEM_SIZE; ++i)
-        memory[i] = i + 5;
-}
+    vector<uint32_t> expected;
+    string line;
+    while (getline(inputFile, line))
+    {
+        if (line.find_first_not_of(" \t\r") != string::npos)
+            expected.push_back(uint32_t(stringToBitset(line + string(32, '0')).to_ulong()));
+    }
 
-void displayCache()
-{
-    for (int i = 0; i < CACHE_ASSOC; i++)
+    const DecodePath paths[] = {DecodePath::Scalar, DecodePath::SSSE3, DecodePath::AVX2};
+    const char *names[] = {"scalar", "ssse3", "avx2"};
+    bool ok = true;
+    for (int p = 0; p < 3 && paths[p] <= bestDecodePath(); ++p)
     {
-        cout << "Cache Block " << i << endl;
-        cout << "Set#\tValid\tHist\tTag\tData" << endl;
-        for (int j = 0; j < CACHE_SIZE / CACHE_ASSOC; ++j)
+        vector<uint32_t> words(expected.size() + 1);
+        vector<Access> records(words.size());
+        const char *cursor = (const char *)text.data();
+        size_t count = decodeAscii(cursor, cursor + text.size(), words.data(), words.size(), paths[p]);
+        size_t decoded = decodeWords(words.data(), count, records.data());
+
+        bool match = count == expected.size();
+        for (size_t i = 0; match && i < count; ++i)
         {
-            bitset<32> data(cache[j][i].data);
-
-            cout << j << "\t";
-            if (cache[j][i].valid)
-            {
-                cout << "1\t";
-                cout << cache[j][i].history << "\t";
-                cout << cache[j][i].tag << "\t";
-                cout << data << endl;
-            }
-            else
-            {
-                // print zeroes instead of empty
-                if (PRINT_ZEROES)
-                {
-
-                    bitset<32> empty(0);
-                    cout << "0\t";
-
-                    if (cache[j][i].history)
-                        cout << "1\t";
-                    else
-                        cout << "0\t";
-
-                    cout << "0000\t";
-                    cout << empty << endl;
-                }
-                else
-                {
-                    cout << "0\t";
-                    if (cache[j][i].history)
-                        cout << "1\t";
-                    else
-                        cout << "0\t";
-                    cout << endl;
-                }
-            }
+            Access access;
+            bool valid = decodeInstruction(bitset<32>(words[i]), access);
+            match = words[i] == expected[i] && valid == (i < decoded);
+            if (!valid)
+                break;
+            match = match && records[i].address == access.address && records[i].isWrite == access.isWrite &&
+                    records[i].reg == access.reg;
         }
-        cout << endl;
+        cout << names[p] << ": " << count << " instructions " << (match ? "match" : "mismatch") << endl;
+        ok = ok && match;
     }
+    return ok;
 }
 
 bitset<32> stringToBitset(string line)
@@ -343,73 +503,3 @@ bitset<32> stringToBitset(string line)
     }
     return instruction;
 }
-
-void displayRegisters()
-{
-    cout << "Registers" << endl;
-    for (int i = 0; i < 8; ++i)
-    {
-        bitset<32> reg(registers[i]);
-        cout << "$s" << i << ": " << reg << endl;
-    }
-    cout << endl;
-}
-
-void initializeRegisters()
-{
-    for (int i = 0; i < 8; ++i)
-    {
-        registers[i] = 0;
-    }
-}
-
-// find least recently used block
-int findLRUBlock(int index)
-{
-    int block = -1;
-
-    // cold start, choose block 0
-    if (cache[index][0].valid == 0 && cache[index][1].valid == 0)
-    {
-        block = 0;
-    }
-    // choose block 0
-    else if (cache[index][0].history == 0)
-    {
-        block = 0;
-    }
-    // choose block 1
-    else if (cache[index][1].history == 0)
-    {
-        block = 1;
-    }
-    return block;
-}
-
-void updateHistoryBits(int index, int block)
-{
-    if (block == 0)
-    {
-        cache[index][0].history = 1;
-        cache[index][1].history = 0;
-    }
-    else if (block == 1)
-    {
-        cache[index][0].history = 0;
-        cache[index][1].history = 1;
-    }
-}
-
-// find write back address
-int findWBAddress(int index, int block)
-{
-    bitset<7> address;
-    address = index;
-
-    for (int i = 3; i < 7; i++)
-    {
-        address[i] = 0;
-        address[i] = cache[index][block].tag[i - 3];
-    }
-    return address.to_ulong();
-}
\ No newline at end of file
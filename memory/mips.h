@@ -0,0 +1,690 @@
+// MIPS32 integer interpreter.
+//
+// A program is decoded once into a table of pre-decoded instructions, with
+// operands split out, immediates extended and branch and jump targets
+// turned into table indices, so executing an instruction is a load of its
+// entry and a jump to its handler. Handlers jump straight to the next
+// handler through a table of label addresses (computed goto); building with
+// MIPS_COMPUTED_GOTO=0, or with a compiler without it, falls back to a
+// switch in a loop.
+//
+// Covered: the ALU, shift, set, mult/div, hi/lo and conditional move
+// instructions, mul, every branch and jump with its delay slot, the byte,
+// half and word loads and stores, syscall and break. Overflow does not trap,
+// add, addi and sub behave as addu, addiu and subu. Writes to $0 are sent
+// to a sink register during decoding so $0 always reads 0.
+//
+// Loads and stores go to a Memory with
+//   std::uint32_t read(std::uint32_t address, unsigned bytes)
+//   void write(std::uint32_t address, std::uint32_t value, unsigned bytes)
+//   std::uint32_t peek(std::uint32_t address, unsigned bytes)
+// taking naturally aligned byte addresses and zero extended values. peek
+// is a read that is not a memory reference of the program, used by the
+// syscall services, so it must not count as an access.
+
+#ifndef MIPS_H
+#define MIPS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#ifndef MIPS_COMPUTED_GOTO
+#if defined(__GNUC__)
+#define MIPS_COMPUTED_GOTO 1
+#else
+#define MIPS_COMPUTED_GOTO 0
+#endif
+#endif
+
+// every operation of the pre-decoded form, in dispatch table order
+#define MIPS_OPS(X) \
+    X(Nop) X(Sll) X(Srl) X(Sra) X(Sllv) X(Srlv) X(Srav) X(Jr) X(Jalr) X(Movz) X(Movn) \
+    X(Syscall) X(Break) X(Mfhi) X(Mthi) X(Mflo) X(Mtlo) X(Mult) X(Multu) X(Div) X(Divu) \
+    X(Add) X(Sub) X(And) X(Or) X(Xor) X(Nor) X(Slt) X(Sltu) X(Mul) \
+    X(Bltz) X(Bgez) X(Bltzal) X(Bgezal) X(J) X(Jal) X(Beq) X(Bne) X(Blez) X(Bgtz) \
+    X(Addi) X(Slti) X(Sltiu) X(Andi) X(Ori) X(Xori) X(Lui) \
+    X(Lb) X(Lh) X(Lw) X(Lbu) X(Lhu) X(Sb) X(Sh) X(Sw) X(Invalid) X(End)
+
+enum class MipsOp : std::uint8_t
+{
+#define MIPS_ENUM(name) name,
+    MIPS_OPS(MIPS_ENUM)
+#undef MIPS_ENUM
+};
+
+enum class MipsExit
+{
+    Exit,         // exit syscall
+    Break,        // break instruction
+    Invalid,      // unknown instruction or syscall
+    AddressError, // unaligned load, store or jump
+    End,          // ran past the program
+    StepLimit     // the instruction budget ran out
+};
+
+inline const char *mipsExitName(MipsExit exit)
+{
+    static const char *names[] = {"exit", "break", "invalid instruction", "address error", "end of program", "step limit"};
+    return names[int(exit)];
+}
+
+struct MipsInstruction
+{
+    MipsOp op = MipsOp::Invalid;
+    std::uint8_t rs = 0;
+    std::uint8_t rt = 0;
+    std::uint8_t rd = 0;       // destination, SINK for $0
+    std::uint32_t imm = 0;     // extended immediate or shift amount
+    std::uint32_t target = 0;  // branch or jump target index
+    std::uint32_t word = 0;    // the encoding, for reporting
+};
+
+class MipsCore
+{
+public:
+    static const unsigned SINK = 32;
+    static const std::uint32_t TEXT_BASE = 0x00400000;
+    static const std::uint32_t STACK_TOP = 0x7ffffffc;
+    static const std::uint32_t GLOBAL_POINTER = 0x10008000;
+
+    explicit MipsCore(std::ostream &console) : console(console) { reset(); }
+
+    // decode the program placed at the base address and start at its first
+    // instruction
+    void load(const std::vector<std::uint32_t> &words, std::uint32_t base = TEXT_BASE)
+    {
+        textBase = base;
+        code.assign(words.size() + 1, MipsInstruction());
+        for (std::size_t i = 0; i < words.size(); ++i)
+            code[i] = decode(words[i], i);
+        code[words.size()].op = MipsOp::End;
+        reset();
+    }
+
+    void reset()
+    {
+        for (std::uint32_t &reg : regs)
+            reg = 0;
+        regs[28] = GLOBAL_POINTER;
+        regs[29] = STACK_TOP;
+        hi = lo = 0;
+        pc = 0;
+        npc = 1;
+        exitCode = 0;
+        executed = 0;
+        faultAddress = 0;
+    }
+
+    // run until the program stops or maxSteps more instructions have run.
+    // The budget is checked at branches and jumps; the one that finds it
+    // spent stops the run without executing and resumes there.
+    template <class Memory>
+    MipsExit run(Memory &memory, std::uint64_t maxSteps = ~std::uint64_t(0))
+    {
+        std::uint32_t *r = regs;
+        const MipsInstruction *text = code.data();
+        const std::uint32_t end = std::uint32_t(code.size() - 1);
+        std::uint32_t current = pc, next = npc;
+        std::uint64_t steps = 0;
+        const MipsInstruction *in;
+        MipsExit exit;
+
+        // current is the slot executing, next the one after it; a branch
+        // changes the one after its delay slot
+#define MIPS_FETCH()            \
+    in = &text[current];        \
+    current = next;             \
+    next = current + 1;         \
+    ++steps
+#define MIPS_BUDGET()           \
+    if (steps >= maxSteps)      \
+    {                           \
+        /* not executed, so not counted */ \
+        steps--;                \
+        exit = MipsExit::StepLimit; \
+        goto stop;              \
+    }
+#define MIPS_JUMP(index)        \
+    next = (index) > end ? end : (index)
+
+#if MIPS_COMPUTED_GOTO
+        static void *const handlers[] = {
+#define MIPS_LABEL(name) &&op_##name,
+            MIPS_OPS(MIPS_LABEL)
+#undef MIPS_LABEL
+        };
+#define MIPS_CASE(name) op_##name:
+#define MIPS_NEXT()                             \
+    do                                          \
+    {                                           \
+        MIPS_FETCH();                           \
+        goto *handlers[int(in->op)];            \
+    } while (0)
+        MIPS_NEXT();
+#else
+#define MIPS_CASE(name) case MipsOp::name:
+#define MIPS_NEXT() continue
+        for (;;)
+        {
+            MIPS_FETCH();
+            switch (in->op)
+            {
+#endif
+
+        MIPS_CASE(Nop)
+            MIPS_NEXT();
+        MIPS_CASE(Sll)
+            r[in->rd] = r[in->rt] << in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Srl)
+            r[in->rd] = r[in->rt] >> in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Sra)
+            r[in->rd] = std::uint32_t(std::int32_t(r[in->rt]) >> in->imm);
+            MIPS_NEXT();
+        MIPS_CASE(Sllv)
+            r[in->rd] = r[in->rt] << (r[in->rs] & 31);
+            MIPS_NEXT();
+        MIPS_CASE(Srlv)
+            r[in->rd] = r[in->rt] >> (r[in->rs] & 31);
+            MIPS_NEXT();
+        MIPS_CASE(Srav)
+            r[in->rd] = std::uint32_t(std::int32_t(r[in->rt]) >> (r[in->rs] & 31));
+            MIPS_NEXT();
+        MIPS_CASE(Jr)
+        {
+            std::uint32_t address = r[in->rs];
+            MIPS_BUDGET();
+            if (address & 3)
+            {
+                faultAddress = address;
+                exit = MipsExit::AddressError;
+                goto stop;
+            }
+            MIPS_JUMP((address - textBase) >> 2);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Jalr)
+        {
+            std::uint32_t address = r[in->rs];
+            MIPS_BUDGET();
+            if (address & 3)
+            {
+                faultAddress = address;
+                exit = MipsExit::AddressError;
+                goto stop;
+            }
+            r[in->rd] = textBase + 4 * (current + 1);
+            MIPS_JUMP((address - textBase) >> 2);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Movz)
+            if (r[in->rt] == 0)
+                r[in->rd] = r[in->rs];
+            MIPS_NEXT();
+        MIPS_CASE(Movn)
+            if (r[in->rt] != 0)
+                r[in->rd] = r[in->rs];
+            MIPS_NEXT();
+        MIPS_CASE(Syscall)
+            if (!syscall(memory))
+            {
+                exit = r[2] == 10 || r[2] == 17 ? MipsExit::Exit : MipsExit::Invalid;
+                goto stop;
+            }
+            MIPS_NEXT();
+        MIPS_CASE(Break)
+            exit = MipsExit::Break;
+            goto stop;
+        MIPS_CASE(Mfhi)
+            r[in->rd] = hi;
+            MIPS_NEXT();
+        MIPS_CASE(Mthi)
+            hi = r[in->rs];
+            MIPS_NEXT();
+        MIPS_CASE(Mflo)
+            r[in->rd] = lo;
+            MIPS_NEXT();
+        MIPS_CASE(Mtlo)
+            lo = r[in->rs];
+            MIPS_NEXT();
+        MIPS_CASE(Mult)
+        {
+            std::int64_t product = std::int64_t(std::int32_t(r[in->rs])) * std::int32_t(r[in->rt]);
+            lo = std::uint32_t(product);
+            hi = std::uint32_t(std::uint64_t(product) >> 32);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Multu)
+        {
+            std::uint64_t product = std::uint64_t(r[in->rs]) * r[in->rt];
+            lo = std::uint32_t(product);
+            hi = std::uint32_t(product >> 32);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Div)
+        {
+            // division by zero leaves hi and lo unpredictable, here unchanged
+            std::int32_t dividend = std::int32_t(r[in->rs]), divisor = std::int32_t(r[in->rt]);
+            if (divisor == -1)
+            {
+                lo = 0u - std::uint32_t(dividend);
+                hi = 0;
+            }
+            else if (divisor != 0)
+            {
+                lo = std::uint32_t(dividend / divisor);
+                hi = std::uint32_t(dividend % divisor);
+            }
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Divu)
+            if (r[in->rt] != 0)
+            {
+                lo = r[in->rs] / r[in->rt];
+                hi = r[in->rs] % r[in->rt];
+            }
+            MIPS_NEXT();
+        MIPS_CASE(Add)
+            r[in->rd] = r[in->rs] + r[in->rt];
+            MIPS_NEXT();
+        MIPS_CASE(Sub)
+            r[in->rd] = r[in->rs] - r[in->rt];
+            MIPS_NEXT();
+        MIPS_CASE(And)
+            r[in->rd] = r[in->rs] & r[in->rt];
+            MIPS_NEXT();
+        MIPS_CASE(Or)
+            r[in->rd] = r[in->rs] | r[in->rt];
+            MIPS_NEXT();
+        MIPS_CASE(Xor)
+            r[in->rd] = r[in->rs] ^ r[in->rt];
+            MIPS_NEXT();
+        MIPS_CASE(Nor)
+            r[in->rd] = ~(r[in->rs] | r[in->rt]);
+            MIPS_NEXT();
+        MIPS_CASE(Slt)
+            r[in->rd] = std::int32_t(r[in->rs]) < std::int32_t(r[in->rt]);
+            MIPS_NEXT();
+        MIPS_CASE(Sltu)
+            r[in->rd] = r[in->rs] < r[in->rt];
+            MIPS_NEXT();
+        MIPS_CASE(Mul)
+            r[in->rd] = std::uint32_t(std::int32_t(r[in->rs]) * std::int64_t(std::int32_t(r[in->rt])));
+            MIPS_NEXT();
+        MIPS_CASE(Bltz)
+            MIPS_BUDGET();
+            if (std::int32_t(r[in->rs]) < 0)
+                next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Bgez)
+            MIPS_BUDGET();
+            if (std::int32_t(r[in->rs]) >= 0)
+                next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Bltzal)
+        {
+            MIPS_BUDGET();
+            bool taken = std::int32_t(r[in->rs]) < 0;
+            r[31] = textBase + 4 * (current + 1);
+            if (taken)
+                next = in->target;
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Bgezal)
+        {
+            MIPS_BUDGET();
+            bool taken = std::int32_t(r[in->rs]) >= 0;
+            r[31] = textBase + 4 * (current + 1);
+            if (taken)
+                next = in->target;
+            MIPS_NEXT();
+        }
+        MIPS_CASE(J)
+            MIPS_BUDGET();
+            next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Jal)
+            MIPS_BUDGET();
+            r[31] = textBase + 4 * (current + 1);
+            next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Beq)
+            MIPS_BUDGET();
+            if (r[in->rs] == r[in->rt])
+                next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Bne)
+            MIPS_BUDGET();
+            if (r[in->rs] != r[in->rt])
+                next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Blez)
+            MIPS_BUDGET();
+            if (std::int32_t(r[in->rs]) <= 0)
+                next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Bgtz)
+            MIPS_BUDGET();
+            if (std::int32_t(r[in->rs]) > 0)
+                next = in->target;
+            MIPS_NEXT();
+        MIPS_CASE(Addi)
+            r[in->rd] = r[in->rs] + in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Slti)
+            r[in->rd] = std::int32_t(r[in->rs]) < std::int32_t(in->imm);
+            MIPS_NEXT();
+        MIPS_CASE(Sltiu)
+            r[in->rd] = r[in->rs] < in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Andi)
+            r[in->rd] = r[in->rs] & in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Ori)
+            r[in->rd] = r[in->rs] | in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Xori)
+            r[in->rd] = r[in->rs] ^ in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Lui)
+            r[in->rd] = in->imm;
+            MIPS_NEXT();
+        MIPS_CASE(Lb)
+            r[in->rd] = std::uint32_t(std::int8_t(memory.read(r[in->rs] + in->imm, 1)));
+            MIPS_NEXT();
+        MIPS_CASE(Lh)
+        {
+            std::uint32_t address = r[in->rs] + in->imm;
+            if (address & 1)
+                goto unaligned;
+            r[in->rd] = std::uint32_t(std::int16_t(memory.read(address, 2)));
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Lw)
+        {
+            std::uint32_t address = r[in->rs] + in->imm;
+            if (address & 3)
+                goto unaligned;
+            r[in->rd] = memory.read(address, 4);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Lbu)
+            r[in->rd] = memory.read(r[in->rs] + in->imm, 1);
+            MIPS_NEXT();
+        MIPS_CASE(Lhu)
+        {
+            std::uint32_t address = r[in->rs] + in->imm;
+            if (address & 1)
+                goto unaligned;
+            r[in->rd] = memory.read(address, 2);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Sb)
+            memory.write(r[in->rs] + in->imm, r[in->rt] & 0xff, 1);
+            MIPS_NEXT();
+        MIPS_CASE(Sh)
+        {
+            std::uint32_t address = r[in->rs] + in->imm;
+            if (address & 1)
+                goto unaligned;
+            memory.write(address, r[in->rt] & 0xffff, 2);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Sw)
+        {
+            std::uint32_t address = r[in->rs] + in->imm;
+            if (address & 3)
+                goto unaligned;
+            memory.write(address, r[in->rt], 4);
+            MIPS_NEXT();
+        }
+        MIPS_CASE(Invalid)
+            exit = MipsExit::Invalid;
+            goto stop;
+        MIPS_CASE(End)
+            // not an instruction, so not counted
+            steps--;
+            exit = MipsExit::End;
+            goto stop;
+
+#if !MIPS_COMPUTED_GOTO
+            }
+        }
+#endif
+#undef MIPS_CASE
+#undef MIPS_NEXT
+#undef MIPS_FETCH
+#undef MIPS_BUDGET
+#undef MIPS_JUMP
+
+    unaligned:
+        faultAddress = r[in->rs] + in->imm;
+        exit = MipsExit::AddressError;
+    stop:
+        // resume at the stopping instruction, after it for syscall and break
+        if (exit == MipsExit::Exit || exit == MipsExit::Break)
+        {
+            pc = current;
+            npc = next;
+        }
+        else
+        {
+            pc = std::uint32_t(in - text);
+            npc = current;
+        }
+        executed += steps;
+        regs[SINK] = 0;
+        return exit;
+    }
+
+    // address of the instruction the core stopped at
+    std::uint32_t pcAddress() const { return textBase + 4 * pc; }
+
+    // the stopping instruction, for reporting
+    std::uint32_t instructionWord(std::uint32_t address) const
+    {
+        std::uint32_t index = (address - textBase) >> 2;
+        return index < code.size() ? code[index].word : 0;
+    }
+
+    std::uint32_t regs[SINK + 1];
+    std::uint32_t hi = 0;
+    std::uint32_t lo = 0;
+    std::uint64_t executed = 0;
+    int exitCode = 0;
+    std::uint32_t faultAddress = 0;
+
+private:
+    MipsInstruction decode(std::uint32_t word, std::size_t index) const
+    {
+        MipsInstruction in;
+        in.word = word;
+        unsigned opcode = word >> 26;
+        in.rs = (word >> 21) & 31;
+        in.rt = (word >> 16) & 31;
+        unsigned rd = (word >> 11) & 31;
+        unsigned shamt = (word >> 6) & 31;
+        unsigned funct = word & 63;
+        std::uint32_t signedImm = std::uint32_t(std::int32_t(std::int16_t(word & 0xffff)));
+        std::uint32_t unsignedImm = word & 0xffff;
+        std::uint32_t end = std::uint32_t(code.size() - 1);
+        // branch targets are relative to the delay slot
+        std::uint32_t branch = std::uint32_t(index + 1) + signedImm;
+        in.target = branch > end ? end : branch;
+        auto dest = [](unsigned reg) { return std::uint8_t(reg == 0 ? SINK : reg); };
+
+        switch (opcode)
+        {
+        case 0:
+        {
+            static const MipsOp special[64] = {
+                MipsOp::Sll, MipsOp::Invalid, MipsOp::Srl, MipsOp::Sra, MipsOp::Sllv, MipsOp::Invalid, MipsOp::Srlv, MipsOp::Srav,
+                MipsOp::Jr, MipsOp::Jalr, MipsOp::Movz, MipsOp::Movn, MipsOp::Syscall, MipsOp::Break, MipsOp::Invalid, MipsOp::Nop,
+                MipsOp::Mfhi, MipsOp::Mthi, MipsOp::Mflo, MipsOp::Mtlo, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid,
+                MipsOp::Mult, MipsOp::Multu, MipsOp::Div, MipsOp::Divu, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid,
+                MipsOp::Add, MipsOp::Add, MipsOp::Sub, MipsOp::Sub, MipsOp::And, MipsOp::Or, MipsOp::Xor, MipsOp::Nor,
+                MipsOp::Invalid, MipsOp::Invalid, MipsOp::Slt, MipsOp::Sltu, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid,
+                MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid,
+                MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid, MipsOp::Invalid};
+            in.op = special[funct];
+            in.rd = dest(rd);
+            in.imm = shamt;
+            // sll $0, $0, 0 and friends are nops; sync (15) is one too
+            if (in.rd == SINK && in.op != MipsOp::Jr && in.op != MipsOp::Jalr && in.op != MipsOp::Syscall &&
+                in.op != MipsOp::Break && in.op != MipsOp::Invalid && in.op != MipsOp::Mthi && in.op != MipsOp::Mtlo &&
+                in.op != MipsOp::Mult && in.op != MipsOp::Multu && in.op != MipsOp::Div && in.op != MipsOp::Divu)
+                in.op = MipsOp::Nop;
+            break;
+        }
+        case 1:
+            in.op = in.rt == 0 ? MipsOp::Bltz : in.rt == 1 ? MipsOp::Bgez : in.rt == 16 ? MipsOp::Bltzal : in.rt == 17 ? MipsOp::Bgezal : MipsOp::Invalid;
+            break;
+        case 2:
+        case 3:
+        {
+            // jumps keep the top bits of the delay slot address
+            std::uint32_t address = ((textBase + 4 * std::uint32_t(index + 1)) & 0xf0000000) | ((word & 0x03ffffff) << 2);
+            std::uint32_t jump = (address - textBase) >> 2;
+            in.target = jump > end ? end : jump;
+            in.op = opcode == 2 ? MipsOp::J : MipsOp::Jal;
+            break;
+        }
+        case 4:
+            in.op = MipsOp::Beq;
+            break;
+        case 5:
+            in.op = MipsOp::Bne;
+            break;
+        case 6:
+            in.op = MipsOp::Blez;
+            break;
+        case 7:
+            in.op = MipsOp::Bgtz;
+            break;
+        case 8:
+        case 9:
+            in.op = MipsOp::Addi;
+            in.imm = signedImm;
+            break;
+        case 10:
+            in.op = MipsOp::Slti;
+            in.imm = signedImm;
+            break;
+        case 11:
+            // compares unsigned against the sign extended immediate
+            in.op = MipsOp::Sltiu;
+            in.imm = signedImm;
+            break;
+        case 12:
+            in.op = MipsOp::Andi;
+            in.imm = unsignedImm;
+            break;
+        case 13:
+            in.op = MipsOp::Ori;
+            in.imm = unsignedImm;
+            break;
+        case 14:
+            in.op = MipsOp::Xori;
+            in.imm = unsignedImm;
+            break;
+        case 15:
+            in.op = MipsOp::Lui;
+            in.imm = unsignedImm << 16;
+            break;
+        case 28:
+            in.op = funct == 2 ? MipsOp::Mul : MipsOp::Invalid;
+            in.rd = dest(rd);
+            break;
+        case 32:
+            in.op = MipsOp::Lb;
+            in.imm = signedImm;
+            break;
+        case 33:
+            in.op = MipsOp::Lh;
+            in.imm = signedImm;
+            break;
+        case 35:
+            in.op = MipsOp::Lw;
+            in.imm = signedImm;
+            break;
+        case 36:
+            in.op = MipsOp::Lbu;
+            in.imm = signedImm;
+            break;
+        case 37:
+            in.op = MipsOp::Lhu;
+            in.imm = signedImm;
+            break;
+        case 40:
+            in.op = MipsOp::Sb;
+            in.imm = signedImm;
+            break;
+        case 41:
+            in.op = MipsOp::Sh;
+            in.imm = signedImm;
+            break;
+        case 43:
+            in.op = MipsOp::Sw;
+            in.imm = signedImm;
+            break;
+        default:
+            in.op = MipsOp::Invalid;
+            break;
+        }
+
+        // immediate forms write rt; a write to $0 that is not a load is a nop
+        if (opcode >= 8 && opcode <= 15)
+        {
+            in.rd = dest(in.rt);
+            if (in.rd == SINK)
+                in.op = MipsOp::Nop;
+        }
+        else if (opcode >= 32 && opcode <= 37)
+            in.rd = dest(in.rt);
+        return in;
+    }
+
+    // the SPIM style services: 1 print int, 4 print string, 10 exit,
+    // 11 print char, 17 exit with code. False when the program stops.
+    template <class Memory>
+    bool syscall(Memory &memory)
+    {
+        switch (regs[2])
+        {
+        case 1:
+            console << std::int32_t(regs[4]);
+            return true;
+        case 4:
+            for (std::uint32_t address = regs[4];; ++address)
+            {
+                char c = char(memory.peek(address, 1));
+                if (c == 0)
+                    break;
+                console << c;
+            }
+            return true;
+        case 11:
+            console << char(regs[4]);
+            return true;
+        case 10:
+            exitCode = 0;
+            return false;
+        case 17:
+            exitCode = int(regs[4]);
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    std::ostream &console;
+    std::vector<MipsInstruction> code;
+    std::uint32_t textBase = TEXT_BASE;
+    std::uint32_t pc = 0;  // instruction index to execute next
+    std::uint32_t npc = 1; // the one after it
+};
+
+#endif
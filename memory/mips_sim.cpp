@@ -0,0 +1,223 @@
+// Execution-driven cache simulation.
+// Runs a MIPS32 program on the interpreter of mips.h and sends every load
+// and store it performs to a CacheSimulator (see simulator.h), so the L1
+// and everything behind it see the references of a real kernel instead of
+// a replayed list.
+//
+// usage: mips_sim [--max-steps N] [--stats json|csv] [--classify] [--regs]
+//                 [--l2 MODE] [--llc MODE] [--write back|through]
+//                 [--write-miss allocate|no-allocate] [--prefetch KIND]
+//                 [--tlb] <program>
+//
+// The program is a text or binary instruction trace as read by trace.h,
+// placed at 0x00400000 and started at its first instruction. Data memory
+// starts zeroed. Loads allocate on a miss and stores do not unless
+// --write-miss says otherwise, as in main.cpp, whose options the cache
+// options here follow. Syscall output goes to stdout and the run summary
+// to stderr. --classify splits the misses that are not compulsory into
+// capacity and conflict ones in the stats.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "cache.h"
+#include "mips.h"
+#include "simulator.h"
+#include "trace.h"
+
+using namespace std;
+
+// 32 KB 8-way L1 with 64 byte lines over 32 bit addresses
+using MipsSimulator = BasicCacheSimulator<Cache<64, 8, 64, 32>>;
+
+// the memory of the core: every load and store is one access of the
+// simulator, which holds the data. Byte and halfword stores merge their
+// lane into the word the simulator already holds before storing it.
+class CachedMemory
+{
+public:
+    explicit CachedMemory(const SimulatorConfig &config) : sim(config) {}
+
+    uint32_t read(uint32_t address, unsigned bytes)
+    {
+        int word = 0;
+        sim.load(address, word);
+        return lane(uint32_t(word), address, bytes);
+    }
+
+    void write(uint32_t address, uint32_t value, unsigned bytes)
+    {
+        if (bytes == 4)
+        {
+            sim.store(address, int(value));
+            return;
+        }
+        // big endian byte lanes, as on MIPS
+        unsigned shift = (4 - bytes - (address & 3)) * 8;
+        uint32_t mask = ((uint32_t(1) << (bytes * 8)) - 1) << shift;
+        uint32_t word = uint32_t(sim.peek(address));
+        sim.store(address, int((word & ~mask) | ((value << shift) & mask)));
+    }
+
+    // a read for syscall services, not counted as an access
+    uint32_t peek(uint32_t address, unsigned bytes) const
+    {
+        return lane(uint32_t(sim.peek(address)), address, bytes);
+    }
+
+    MipsSimulator sim;
+
+private:
+    static uint32_t lane(uint32_t word, uint32_t address, unsigned bytes)
+    {
+        if (bytes == 4)
+            return word;
+        unsigned shift = (4 - bytes - (address & 3)) * 8;
+        return (word >> shift) & ((uint32_t(1) << (bytes * 8)) - 1);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxSteps = ~uint64_t(0);
+    string statsFormat;
+    bool showRegisters = false;
+    string fileName;
+    SimulatorConfig config;
+    config.memoryInitializer = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--max-steps" && i + 1 < argc)
+            maxSteps = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--stats" && i + 1 < argc)
+            statsFormat = argv[++i]; // json or csv
+        else if (arg == "--classify")
+            config.classifyMisses = Stats::ENABLED;
+        else if (arg == "--regs")
+            showRegisters = true;
+        else if ((arg == "--l2" || arg == "--llc") && i + 1 < argc)
+        {
+            // nine, inclusive or exclusive
+            string mode = argv[++i];
+            Inclusion inclusion;
+            if (mode == "nine")
+                inclusion = Inclusion::NINE;
+            else if (mode == "inclusive")
+                inclusion = Inclusion::Inclusive;
+            else if (mode == "exclusive")
+                inclusion = Inclusion::Exclusive;
+            else
+            {
+                cerr << "Unknown inclusion mode " << mode << endl;
+                return 1;
+            }
+            if (arg == "--l2")
+                config.l2Inclusion = inclusion;
+            else
+                config.l3Inclusion = inclusion;
+            config.useHierarchy = true;
+        }
+        else if (arg == "--write" && i + 1 < argc)
+        {
+            string mode = argv[++i];
+            if (mode == "back")
+                config.writePolicy = WritePolicy::WriteBack;
+            else if (mode == "through")
+                config.writePolicy = WritePolicy::WriteThrough;
+            else
+            {
+                cerr << "Unknown write policy " << mode << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--write-miss" && i + 1 < argc)
+        {
+            string mode = argv[++i];
+            if (mode == "allocate")
+                config.writeMiss = WriteMiss::Allocate;
+            else if (mode == "no-allocate")
+                config.writeMiss = WriteMiss::NoAllocate;
+            else
+            {
+                cerr << "Unknown write miss policy " << mode << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--prefetch" && i + 1 < argc)
+        {
+            // none, next-line, stride or stream
+            string kind = argv[++i];
+            if (kind == "none")
+                config.prefetchKind = PrefetchKind::None;
+            else if (kind == "next-line")
+                config.prefetchKind = PrefetchKind::NextLine;
+            else if (kind == "stride")
+                config.prefetchKind = PrefetchKind::Stride;
+            else if (kind == "stream")
+                config.prefetchKind = PrefetchKind::Stream;
+            else
+            {
+                cerr << "Unknown prefetcher " << kind << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--tlb")
+            config.useTLB = true;
+        else
+            fileName = arg;
+    }
+    if (fileName.empty())
+    {
+        cerr << "usage: " << argv[0] << " [--max-steps N] [--stats json|csv] [--classify] [--regs] [--l2 MODE] [--llc MODE]"
+             << " [--write back|through] [--write-miss allocate|no-allocate] [--prefetch KIND] [--tlb] <program>" << endl;
+        return 1;
+    }
+
+    vector<uint32_t> program;
+    if (!loadInstructions(fileName, program))
+    {
+        cerr << "Unable to open file " << fileName << endl;
+        return 1;
+    }
+
+    MipsCore core(cout);
+    core.load(program);
+    CachedMemory memory(config);
+
+    auto start = chrono::steady_clock::now();
+    MipsExit exit = core.run(memory, maxSteps);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    memory.sim.flush();
+    cout << flush;
+
+    cerr << mipsExitName(exit);
+    if (exit == MipsExit::Exit)
+        cerr << " " << core.exitCode;
+    if (exit == MipsExit::AddressError)
+        cerr << " at 0x" << hex << core.faultAddress << dec;
+    if (exit == MipsExit::Invalid || exit == MipsExit::AddressError)
+        cerr << ", pc 0x" << hex << core.pcAddress() << " instruction 0x" << setw(8) << setfill('0')
+             << core.instructionWord(core.pcAddress()) << dec << setfill(' ');
+    cerr << ", " << core.executed << " instructions, " << fixed << setprecision(3) << elapsed << " s, "
+         << setprecision(1) << (elapsed > 0 ? core.executed / elapsed / 1e6 : 0.0) << " MIPS" << endl;
+
+    if (showRegisters)
+    {
+        for (unsigned reg = 0; reg < 32; ++reg)
+            cerr << "$" << reg << " = 0x" << hex << setw(8) << setfill('0') << core.regs[reg] << dec << setfill(' ')
+                 << (reg % 4 == 3 ? "\n" : "\t");
+        cerr << "hi = 0x" << hex << core.hi << "\tlo = 0x" << core.lo << dec << endl;
+    }
+
+    if (statsFormat == "json")
+        memory.sim.writeJSON(cout);
+    else if (statsFormat == "csv")
+        memory.sim.writeCSV(cout);
+    return exit == MipsExit::Exit || exit == MipsExit::End || exit == MipsExit::Break ? core.exitCode : 1;
+}
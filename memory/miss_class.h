@@ -0,0 +1,255 @@
+// Compulsory, capacity and conflict miss classification.
+//
+// A miss is compulsory when its line was never referenced before, which a
+// first touch bitmap answers. Otherwise it is a capacity miss when a fully
+// associative LRU cache of the same number of lines, fed the same
+// references, would also have missed, and a conflict miss when only the
+// limited associativity caused it. The shadow cache is an intrusive recency
+// list of preallocated nodes plus an open addressing table from line to
+// node, sized once for the cache, so each reference is O(1) and does not
+// allocate.
+
+#ifndef MISS_CLASS_H
+#define MISS_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum class MissClass : std::uint8_t
+{
+    Hit,
+    Compulsory,
+    Capacity,
+    Conflict,
+    Other // not the first reference, capacity or conflict not told apart
+};
+
+inline const char *missClassName(MissClass missClass)
+{
+    static const char *names[] = {"hit", "compulsory", "capacity", "conflict", "other"};
+    return names[int(missClass)];
+}
+
+// one bit per line ever referenced, in 4096 line pages allocated on first
+// touch
+class FirstTouchMap
+{
+public:
+    static const unsigned PAGE_BITS = 12;
+
+    // mark the line, true if it had not been referenced before
+    bool touch(std::uint64_t line)
+    {
+        std::vector<std::uint64_t> &page = pages[line >> PAGE_BITS];
+        if (page.empty())
+            page.assign((std::size_t(1) << PAGE_BITS) / 64, 0);
+        std::size_t bit = line & ((std::uint64_t(1) << PAGE_BITS) - 1);
+        std::uint64_t mask = std::uint64_t(1) << (bit % 64);
+        bool first = !(page[bit / 64] & mask);
+        page[bit / 64] |= mask;
+        return first;
+    }
+
+    void clear() { pages.clear(); }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(pages);
+    }
+
+private:
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> pages;
+};
+
+// fully associative LRU cache of line numbers
+class ShadowLRU
+{
+public:
+    explicit ShadowLRU(std::size_t lines) : capacity(lines ? lines : 1)
+    {
+        // at most half full, so every probe run ends at an empty slot
+        std::size_t slots = 2;
+        while (slots < 2 * capacity)
+            slots *= 2;
+        where.assign(slots, std::uint32_t(NONE));
+        shift = 64 - log2Of(slots);
+        nodes.reserve(capacity);
+    }
+
+    // reference the line, true on a hit. A miss inserts it, evicting the
+    // least recently used line when full.
+    bool access(std::uint64_t line)
+    {
+        std::size_t slot = find(line);
+        if (where[slot] != NONE)
+        {
+            moveToFront(where[slot]);
+            return true;
+        }
+
+        std::uint32_t node;
+        if (nodes.size() < capacity)
+        {
+            node = std::uint32_t(nodes.size());
+            nodes.push_back(Node());
+        }
+        else
+        {
+            node = tail;
+            unlink(node);
+            erase(nodes[node].line);
+            slot = find(line);
+        }
+        nodes[node].line = line;
+        pushFront(node);
+        where[slot] = node;
+        return false;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(capacity, nodes, where, shift, head, tail);
+    }
+
+private:
+    static const std::uint32_t NONE = ~std::uint32_t(0);
+
+    struct Node
+    {
+        std::uint64_t line = 0;
+        std::uint32_t prev = NONE;
+        std::uint32_t next = NONE;
+    };
+
+    static unsigned log2Of(std::size_t n)
+    {
+        unsigned bits = 0;
+        while (n > 1)
+        {
+            n /= 2;
+            bits++;
+        }
+        return bits;
+    }
+
+    // the slot a line's probe run starts at, by Fibonacci hashing
+    std::size_t home(std::uint64_t line) const
+    {
+        return std::size_t((line * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    // the slot holding the line, or the empty slot that ends its probe run
+    std::size_t find(std::uint64_t line) const
+    {
+        std::size_t mask = where.size() - 1;
+        for (std::size_t slot = home(line);; slot = (slot + 1) & mask)
+        {
+            std::uint32_t node = where[slot];
+            if (node == NONE || nodes[node].line == line)
+                return slot;
+        }
+    }
+
+    // remove a line that is in the table, moving later entries of its probe
+    // run back so no run is broken by the hole
+    void erase(std::uint64_t line)
+    {
+        std::size_t mask = where.size() - 1;
+        std::size_t hole = find(line);
+        for (std::size_t slot = (hole + 1) & mask; where[slot] != NONE; slot = (slot + 1) & mask)
+        {
+            // an entry may fill the hole if the hole lies between its home
+            // slot and where it sits
+            if (((slot - home(nodes[where[slot]].line)) & mask) >= ((slot - hole) & mask))
+            {
+                where[hole] = where[slot];
+                hole = slot;
+            }
+        }
+        where[hole] = NONE;
+    }
+
+    void unlink(std::uint32_t node)
+    {
+        Node &n = nodes[node];
+        if (n.prev != NONE)
+            nodes[n.prev].next = n.next;
+        else
+            head = n.next;
+        if (n.next != NONE)
+            nodes[n.next].prev = n.prev;
+        else
+            tail = n.prev;
+        n.prev = n.next = NONE;
+    }
+
+    void pushFront(std::uint32_t node)
+    {
+        nodes[node].next = head;
+        if (head != NONE)
+            nodes[head].prev = node;
+        head = node;
+        if (tail == NONE)
+            tail = node;
+    }
+
+    void moveToFront(std::uint32_t node)
+    {
+        if (node != head)
+        {
+            unlink(node);
+            pushFront(node);
+        }
+    }
+
+    std::size_t capacity;
+    std::vector<Node> nodes;
+    // node of each line, NONE in empty slots
+    std::vector<std::uint32_t> where;
+    unsigned shift = 63;
+    std::uint32_t head = NONE;
+    std::uint32_t tail = NONE;
+};
+
+// classifies every reference of a cache with the given number of lines.
+// With split false no shadow cache is fed and misses are only compulsory or
+// Other, which needs nothing but the first touch bitmap.
+class MissClassifier
+{
+public:
+    MissClassifier(std::size_t lines, bool split) : shadow(split ? lines : 1), split(split) {}
+
+    // hit is the outcome in the real cache
+    MissClass classify(std::uint64_t line, bool hit)
+    {
+        bool first = firstTouch.touch(line);
+        if (!split)
+            return hit ? MissClass::Hit : first ? MissClass::Compulsory : MissClass::Other;
+        bool shadowHit = shadow.access(line);
+        if (hit)
+            return MissClass::Hit;
+        if (first)
+            return MissClass::Compulsory;
+        return shadowHit ? MissClass::Conflict : MissClass::Capacity;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(firstTouch, shadow, split);
+    }
+
+private:
+    FirstTouchMap firstTouch;
+    ShadowLRU shadow;
+    bool split;
+};
+
+#endif
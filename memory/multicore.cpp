@@ -0,0 +1,136 @@
+// Multicore coherence simulation.
+// Every trace is the lw/sw stream of one core; the traces are interleaved
+// round robin, a quantum of accesses per core per turn, through private
+// caches kept coherent by a MESI or MOESI snooping bus (see coherence.h).
+//
+// usage: multicore [--protocol mesi|moesi] [--quantum N] [--top N] [--check]
+//                  <trace0> <trace1> ...
+//
+// Prints per core hits and cold, replacement, true and false sharing
+// misses, the bus transactions, and the lines with the most coherence
+// misses. --check verifies the single writer invariant after every access.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include "cache.h"
+#include "coherence.h"
+#include "trace.h"
+
+using namespace std;
+
+// 16 KB 4-way private caches with 64 byte lines
+using CoreCache = Cache<64, 4, 64, 32>;
+
+int main(int argc, char *argv[])
+{
+    Protocol protocol = Protocol::MESI;
+    size_t quantum = 1;
+    size_t top = 10;
+    bool check = false;
+    vector<string> fileNames;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--protocol" && i + 1 < argc)
+        {
+            string name = argv[++i];
+            if (name != "mesi" && name != "moesi")
+            {
+                cerr << "Unknown protocol " << name << endl;
+                return 1;
+            }
+            protocol = name == "moesi" ? Protocol::MOESI : Protocol::MESI;
+        }
+        else if (arg == "--quantum" && i + 1 < argc)
+            quantum = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--top" && i + 1 < argc)
+            top = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--check")
+            check = true;
+        else
+            fileNames.push_back(arg);
+    }
+    if (fileNames.empty() || quantum == 0)
+    {
+        cerr << "usage: " << argv[0] << " [--protocol mesi|moesi] [--quantum N] [--top N] [--check] <trace0> <trace1> ..." << endl;
+        return 1;
+    }
+
+    vector<vector<Access>> traces;
+    for (const string &fileName : fileNames)
+    {
+        vector<uint32_t> instructions;
+        if (!loadInstructions(fileName, instructions))
+        {
+            cerr << "Unable to open file " << fileName << endl;
+            return 1;
+        }
+        traces.push_back(decodeAccesses(instructions));
+    }
+
+    CoherentCaches<CoreCache> system(traces.size(), protocol);
+    vector<size_t> next(traces.size(), 0);
+    bool running = true;
+    while (running)
+    {
+        running = false;
+        for (size_t core = 0; core < traces.size(); ++core)
+        {
+            const vector<Access> &trace = traces[core];
+            for (size_t n = 0; n < quantum && next[core] < trace.size(); ++n)
+            {
+                const Access &access = trace[next[core]++];
+                system.access(core, access.address, access.isWrite);
+                if (check && !system.coherent(access.address))
+                {
+                    cerr << "Coherence violated by core " << core << " at address " << access.address << endl;
+                    return 1;
+                }
+            }
+            running = running || next[core] < trace.size();
+        }
+    }
+
+    cout << protocolName(protocol) << ", " << traces.size() << " cores, " << CoreCache::SIZE_BYTES << " byte "
+         << CoreCache::WAYS << "-way private caches, " << CoreCache::LINE_BYTES << " byte lines" << endl;
+    cout << "Core\tReads\tWrites\tRd hits\tWr hits\tCold\tRepl\tTrue sh\tFalse sh\tUpgrades\tInval recv" << endl;
+    for (size_t core = 0; core < system.size(); ++core)
+    {
+        const CoreStats &stats = system.coreStats(core);
+        cout << core << "\t" << stats.reads << "\t" << stats.writes << "\t" << stats.readHits << "\t"
+             << stats.writeHits << "\t" << stats.coldMisses << "\t" << stats.replacementMisses << "\t"
+             << stats.trueSharingMisses << "\t" << stats.falseSharingMisses << "\t" << stats.upgrades << "\t"
+             << stats.invalidationsReceived << endl;
+    }
+
+    const BusStats &bus = system.busStats();
+    cout << "Bus\tBusRd " << bus.reads << "\tBusRdX " << bus.readExclusives << "\tBusUpgr " << bus.upgrades
+         << "\tInvalidations " << bus.invalidations << "\tCache-to-cache " << bus.cacheToCache << "\tWritebacks "
+         << bus.writebacks << endl;
+
+    // lines with the most coherence misses, false sharing first
+    vector<pair<uint64_t, LineSharing>> lines(system.lineSharing().begin(), system.lineSharing().end());
+    sort(lines.begin(), lines.end(), [](const pair<uint64_t, LineSharing> &a, const pair<uint64_t, LineSharing> &b)
+         {
+             if (a.second.falseSharingMisses != b.second.falseSharingMisses)
+                 return a.second.falseSharingMisses > b.second.falseSharingMisses;
+             if (a.second.trueSharingMisses != b.second.trueSharingMisses)
+                 return a.second.trueSharingMisses > b.second.trueSharingMisses;
+             return a.first < b.first;
+         });
+    if (lines.size() > top)
+        lines.resize(top);
+    cout << "Line\tInvalidations\tTrue sh\tFalse sh" << endl;
+    for (const auto &line : lines)
+    {
+        cout << "0x" << hex << (line.first << CoreCache::OFFSET_BITS) << dec << "\t" << line.second.invalidations
+             << "\t" << line.second.trueSharingMisses << "\t" << line.second.falseSharingMisses << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,326 @@
+// Pipelined trace ingestion.
+//
+// A TraceReader reads a text, binary or delta coded trace on its own thread
+// and decodes it into batches of access records, which it hands to the
+// simulation thread through a single producer, single consumer ring. The
+// simulation thread gives each batch back through a second ring once it is
+// done with it. A fixed pool of batches is reused, so the steady state does
+// not allocate, and reading and decoding overlap with simulation. A side
+// that finds its ring empty spins briefly, then sleeps until the other side
+// pushes, so neither burns a core waiting on a slower partner.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "decode.h"
+#include "trace.h"
+
+// bounded lock-free queue for one producer and one consumer thread. Each
+// side keeps a copy of the other's index and reloads it only when the ring
+// looks full or empty.
+template <class T, std::size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // producer side, false when the ring is full
+    bool push(const T &value)
+    {
+        std::size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headCache == Capacity)
+        {
+            headCache = headIndex.load(std::memory_order_acquire);
+            if (tail - headCache == Capacity)
+                return false;
+        }
+        slots[tail & (Capacity - 1)] = value;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false when the ring is empty
+    bool pop(T &value)
+    {
+        std::size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailCache)
+        {
+            tailCache = tailIndex.load(std::memory_order_acquire);
+            if (head == tailCache)
+                return false;
+        }
+        value = slots[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // the producer's line, then the consumer's, so neither writes to a line
+    // the other keeps reading
+    alignas(64) std::atomic<std::size_t> tailIndex{0};
+    std::size_t headCache = 0;
+    alignas(64) std::atomic<std::size_t> headIndex{0};
+    std::size_t tailCache = 0;
+    alignas(64) T slots[Capacity];
+};
+
+// lets one thread sleep until another has made its condition true. The
+// waiter announces itself before its last check and the waker looks for it
+// after making the change, each behind a full fence, so either the waiter
+// sees the change or the waker sees the waiter; the mutex keeps the wakeup
+// from landing between that check and the sleep.
+class Waiter
+{
+public:
+    // polls before sleeping, enough to ride out a short gap
+    static const int SPINS = 64;
+
+    // return once ready() is true; ready() may take what it waits for
+    template <class Ready>
+    void wait(Ready ready)
+    {
+        for (int i = 0; i < SPINS; ++i)
+        {
+            if (ready())
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!ready())
+            wakeup.wait(lock);
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    // after making the waiter's condition true
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeup.notify_one();
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> sleeping{false};
+};
+
+// a run of lw and sw records, each decoded from the word at the same index,
+// ended by the word that stopped decoding when it is not the end of a block
+struct TraceBatch
+{
+    static const std::size_t CAPACITY = 4096;
+
+    std::uint32_t words[CAPACITY];
+    Access records[CAPACITY];
+    std::size_t count = 0;
+    bool hasStop = false;
+    std::uint32_t stop = 0;
+
+    // trace instructions the batch covers
+    std::size_t size() const { return count + (hasStop ? 1 : 0); }
+};
+
+class TraceReader
+{
+public:
+    static const std::size_t BATCHES = 8;
+
+    TraceReader() : pool(BATCHES) {}
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+    ~TraceReader() { close(); }
+
+    // open the trace and start reading it, false if it cannot be opened.
+    // A binary trace starts at instruction first, the others, which cannot
+    // seek, at their beginning; startPosition() tells which.
+    bool open(const std::string &path, std::uint64_t first = 0)
+    {
+        close();
+        start = 0;
+        bool isTrace = binary.open(path);
+        if (isTrace && binary.recordKind() == TRACE_INSTRUCTIONS)
+        {
+            kind = TRACE_INSTRUCTIONS;
+            start = next = first;
+        }
+        else if (isTrace && binary.recordKind() == TRACE_DELTA)
+        {
+            kind = TRACE_DELTA;
+            deltas = binary.deltas();
+        }
+        else
+        {
+            binary.close();
+            kind = 0;
+            if (!text.open(path) || hasTraceMagic(text))
+            {
+                finished = true; // nothing to read, nextBatch() ends at once
+                return false;
+            }
+            cursor = (const char *)text.data();
+            textEnd = cursor + text.size();
+        }
+
+        for (TraceBatch &batch : pool)
+            empty.push(&batch);
+        cancelled = false;
+        worker = std::thread([this] { produce(); });
+        return true;
+    }
+
+    std::uint64_t startPosition() const { return start; }
+
+    // the next batch, waiting for the reader, or null at the end of the
+    // trace. Hand it back with release() once done with it.
+    TraceBatch *nextBatch()
+    {
+        TraceBatch *batch = nullptr;
+        if (finished)
+            return nullptr;
+        fullWaiter.wait([&] { return full.pop(batch); });
+        finished = batch == nullptr;
+        return batch;
+    }
+
+    void release(TraceBatch *batch)
+    {
+        empty.push(batch);
+        emptyWaiter.wake();
+    }
+
+    // stop the reader thread, which may not have reached the end
+    void close()
+    {
+        if (worker.joinable())
+        {
+            cancelled = true;
+            emptyWaiter.wake();
+            worker.join();
+        }
+        // drop whatever is left in the rings
+        TraceBatch *batch;
+        while (full.pop(batch))
+        {
+        }
+        while (empty.pop(batch))
+        {
+        }
+        finished = false;
+        text.close();
+        binary.close();
+    }
+
+private:
+    // the reader thread: fill batches from the trace until its end, then
+    // send null
+    void produce()
+    {
+        std::uint32_t words[TraceBatch::CAPACITY];
+        std::size_t used = 0, available = 0;
+        TraceBatch *batch = acquire();
+        while (batch)
+        {
+            if (used == available)
+            {
+                used = 0;
+                available = read(words, TraceBatch::CAPACITY);
+                if (available == 0)
+                    break;
+            }
+            std::size_t n = available - used;
+            if (n > TraceBatch::CAPACITY - batch->count)
+                n = TraceBatch::CAPACITY - batch->count;
+            std::size_t decoded = decodeWords(words + used, n, batch->records + batch->count);
+            std::memcpy(batch->words + batch->count, words + used, decoded * sizeof(std::uint32_t));
+            batch->count += decoded;
+            used += decoded;
+
+            if (decoded < n)
+            {
+                batch->hasStop = true;
+                batch->stop = words[used++];
+            }
+            if (batch->hasStop || batch->count == TraceBatch::CAPACITY)
+            {
+                publish(batch);
+                batch = acquire();
+            }
+        }
+        if (batch && batch->count)
+        {
+            publish(batch);
+            batch = nullptr;
+        }
+        if (!cancelled)
+            publish(nullptr);
+    }
+
+    // an empty batch from the pool, null once cancelled
+    TraceBatch *acquire()
+    {
+        TraceBatch *batch = nullptr;
+        emptyWaiter.wait([&] { return empty.pop(batch) || cancelled; });
+        if (!batch)
+            return nullptr;
+        batch->count = 0;
+        batch->hasStop = false;
+        return batch;
+    }
+
+    void publish(TraceBatch *batch)
+    {
+        // the ring holds the whole pool and the end marker, so it never fills
+        full.push(batch);
+        fullWaiter.wake();
+    }
+
+    // the next instruction words of the trace, 0 at its end
+    std::size_t read(std::uint32_t *words, std::size_t max)
+    {
+        if (kind == TRACE_INSTRUCTIONS)
+        {
+            std::size_t n = binary.instructions(next, words, max);
+            next += n;
+            return n;
+        }
+        if (kind == TRACE_DELTA)
+            return deltas.read(words, max);
+        return decodeAscii(cursor, textEnd, words, max);
+    }
+
+    std::vector<TraceBatch> pool;
+    SpscRing<TraceBatch *, 2 * BATCHES> full;
+    SpscRing<TraceBatch *, 2 * BATCHES> empty;
+    // the simulation thread waits on full, the reader on empty
+    Waiter fullWaiter;
+    Waiter emptyWaiter;
+    std::thread worker;
+    std::atomic<bool> cancelled{false};
+    bool finished = false;
+
+    std::uint16_t kind = 0;
+    std::uint64_t start = 0;
+    TraceFile binary;
+    std::uint64_t next = 0;
+    DeltaReader deltas;
+    MappedFile text;
+    const char *cursor = nullptr;
+    const char *textEnd = nullptr;
+};
+
+#endif
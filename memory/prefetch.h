@@ -0,0 +1,429 @@
+// Hardware prefetcher models.
+//
+// A prefetcher watches the demand stream of a cache and proposes lines to
+// fetch before they are asked for. It only sees addresses; the caller
+// filters lines already present, fills them into the cache or a separate
+// PrefetchBuffer and keeps the accuracy, coverage and lateness counters.
+//
+//   next-line  on a miss, or the first use of a prefetched line, fetch the
+//              following lines
+//   stride     reference prediction table indexed by the instruction,
+//              fetches ahead once the same stride is seen twice in a row
+//   stream     a few stream buffers that follow ascending or descending
+//              runs of misses, running a fixed depth ahead of the demand
+//
+// Addresses are byte addresses and the proposed ones are line aligned.
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class PrefetchKind
+{
+    None,
+    NextLine,
+    Stride,
+    Stream
+};
+
+inline const char *prefetchName(PrefetchKind kind)
+{
+    switch (kind)
+    {
+    case PrefetchKind::NextLine:
+        return "next-line";
+    case PrefetchKind::Stride:
+        return "stride";
+    case PrefetchKind::Stream:
+        return "stream";
+    default:
+        return "none";
+    }
+}
+
+// lines proposed for one demand access. A prefetcher proposes at most its
+// degree, so drivers reject degrees above MAX_LINES.
+struct PrefetchRequests
+{
+    static const int MAX_LINES = 8;
+
+    std::uint64_t address[MAX_LINES];
+    int count = 0;
+
+    void add(std::uint64_t lineAddress)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (address[i] == lineAddress)
+                return;
+        }
+        if (count < MAX_LINES)
+            address[count++] = lineAddress;
+    }
+};
+
+class NextLinePrefetcher
+{
+public:
+    void configure(std::size_t prefetchLineBytes, unsigned prefetchDegree)
+    {
+        lineBytes = prefetchLineBytes;
+        degree = prefetchDegree;
+    }
+
+    void observe(std::uint64_t, std::uint64_t address, bool trigger, PrefetchRequests &requests)
+    {
+        if (!trigger)
+            return;
+        std::uint64_t line = address / lineBytes;
+        for (unsigned i = 1; i <= degree; ++i)
+            requests.add((line + i) * lineBytes);
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(lineBytes, degree);
+    }
+
+private:
+    std::size_t lineBytes = 4;
+    unsigned degree = 1;
+};
+
+class StridePrefetcher
+{
+public:
+    static const std::size_t ENTRIES = 64;
+
+    void configure(std::size_t prefetchLineBytes, unsigned prefetchDegree)
+    {
+        lineBytes = prefetchLineBytes;
+        degree = prefetchDegree;
+        table.assign(ENTRIES, Entry());
+    }
+
+    void observe(std::uint64_t pc, std::uint64_t address, bool, PrefetchRequests &requests)
+    {
+        Entry &entry = table[pc % ENTRIES];
+        if (!entry.valid || entry.pc != pc)
+        {
+            entry = Entry();
+            entry.valid = true;
+            entry.pc = pc;
+            entry.last = address;
+            return;
+        }
+
+        std::int64_t stride = std::int64_t(address - entry.last);
+        bool same = stride == entry.stride;
+        switch (entry.state)
+        {
+        case State::Initial:
+            entry.state = same ? State::Steady : State::Transient;
+            break;
+        case State::Transient:
+            entry.state = same ? State::Steady : State::NoPrediction;
+            break;
+        case State::Steady:
+            entry.state = same ? State::Steady : State::Initial;
+            break;
+        case State::NoPrediction:
+            entry.state = same ? State::Transient : State::NoPrediction;
+            break;
+        }
+        // a steady entry keeps its stride through one irregular access
+        if (!same && entry.state != State::Initial)
+            entry.stride = stride;
+        entry.last = address;
+
+        if (entry.state == State::Steady && entry.stride != 0)
+        {
+            std::uint64_t line = address / lineBytes;
+            for (unsigned i = 1; i <= degree; ++i)
+            {
+                std::uint64_t target = address + std::uint64_t(entry.stride * std::int64_t(i));
+                if (target / lineBytes != line)
+                    requests.add(target / lineBytes * lineBytes);
+            }
+        }
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(lineBytes, degree, table);
+    }
+
+private:
+    enum class State : std::uint8_t
+    {
+        Initial,
+        Transient,
+        Steady,
+        NoPrediction
+    };
+
+    struct Entry
+    {
+        bool valid = false;
+        State state = State::Initial;
+        std::uint64_t pc = 0;
+        std::uint64_t last = 0;
+        std::int64_t stride = 0;
+    };
+
+    std::size_t lineBytes = 4;
+    unsigned degree = 1;
+    std::vector<Entry> table;
+};
+
+class StreamPrefetcher
+{
+public:
+    static const std::size_t STREAMS = 4;
+
+    void configure(std::size_t prefetchLineBytes, unsigned prefetchDepth)
+    {
+        lineBytes = prefetchLineBytes;
+        depth = prefetchDepth;
+        streams.assign(STREAMS, Stream());
+        clock = 0;
+    }
+
+    void observe(std::uint64_t, std::uint64_t address, bool trigger, PrefetchRequests &requests)
+    {
+        if (!trigger)
+            return;
+        std::int64_t line = std::int64_t(address / lineBytes);
+        clock++;
+
+        // a confirmed stream whose window holds the line advances past it
+        for (Stream &stream : streams)
+        {
+            std::int64_t ahead = (line - stream.next) * stream.direction;
+            if (stream.valid && stream.confirmed && ahead >= 0 && ahead < std::int64_t(depth))
+            {
+                advance(stream, line, requests);
+                return;
+            }
+        }
+
+        // a miss next to the first miss of a new stream gives its direction
+        for (Stream &stream : streams)
+        {
+            if (stream.valid && !stream.confirmed && (line == stream.last + 1 || line == stream.last - 1))
+            {
+                stream.confirmed = true;
+                stream.direction = line > stream.last ? 1 : -1;
+                advance(stream, line, requests);
+                return;
+            }
+        }
+
+        // otherwise start a new stream in the least recently used slot
+        Stream *victim = &streams[0];
+        for (Stream &stream : streams)
+        {
+            if (!stream.valid || stream.used < victim->used)
+                victim = &stream;
+        }
+        *victim = Stream();
+        victim->valid = true;
+        victim->last = line;
+        victim->used = clock;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(lineBytes, depth, streams, clock);
+    }
+
+private:
+    struct Stream
+    {
+        bool valid = false;
+        bool confirmed = false;
+        std::int64_t last = 0;      // first miss, until the direction is known
+        std::int64_t next = 0;      // next line the demand is expected at
+        std::int64_t direction = 1; // +1 ascending, -1 descending
+        std::uint64_t used = 0;
+    };
+
+    // move the stream past the line and fetch the depth lines after it
+    void advance(Stream &stream, std::int64_t line, PrefetchRequests &requests)
+    {
+        stream.next = line + stream.direction;
+        stream.used = clock;
+        for (unsigned i = 0; i < depth; ++i)
+        {
+            std::int64_t target = stream.next + std::int64_t(i) * stream.direction;
+            if (target >= 0)
+                requests.add(std::uint64_t(target) * lineBytes);
+        }
+    }
+
+    std::size_t lineBytes = 4;
+    unsigned depth = 4;
+    std::vector<Stream> streams;
+    std::uint64_t clock = 0;
+};
+
+// the selected prefetcher, none by default
+class Prefetcher
+{
+public:
+    // degree is the lines fetched per trigger, the stream depth for streams
+    void configure(PrefetchKind prefetchKind, std::size_t lineBytes, unsigned degree)
+    {
+        kind = prefetchKind;
+        nextLine.configure(lineBytes, degree);
+        stride.configure(lineBytes, degree);
+        stream.configure(lineBytes, degree);
+    }
+
+    PrefetchKind getKind() const { return kind; }
+
+    // pc identifies the instruction, trigger is a demand miss or the first
+    // use of a prefetched line
+    void observe(std::uint64_t pc, std::uint64_t address, bool trigger, PrefetchRequests &requests)
+    {
+        switch (kind)
+        {
+        case PrefetchKind::NextLine:
+            nextLine.observe(pc, address, trigger, requests);
+            break;
+        case PrefetchKind::Stride:
+            stride.observe(pc, address, trigger, requests);
+            break;
+        case PrefetchKind::Stream:
+            stream.observe(pc, address, trigger, requests);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(kind, nextLine, stride, stream);
+    }
+
+private:
+    PrefetchKind kind = PrefetchKind::None;
+    NextLinePrefetcher nextLine;
+    StridePrefetcher stride;
+    StreamPrefetcher stream;
+};
+
+// small fully associative buffer that holds prefetched lines apart from the
+// cache, oldest replaced first. The lines sit in a ring of entries slots in
+// the order they arrived. A line an exclusive level handed up keeps its
+// dirty bit here, and the caller must write back or pass down every line
+// that leaves without being taken.
+class PrefetchBuffer
+{
+public:
+    struct Entry
+    {
+        std::uint64_t address = 0;
+        std::uint64_t readyAt = 0;
+        bool dirty = false;
+    };
+
+    void configure(std::size_t bufferEntries)
+    {
+        entries = bufferEntries;
+        lines.assign(entries, Entry());
+        oldest = 0;
+        count = 0;
+    }
+
+    std::size_t capacity() const { return entries; }
+
+    bool contains(std::uint64_t lineAddress) const
+    {
+        return find(lineAddress) != count;
+    }
+
+    // add the line, true with the oldest line in displaced if it made room
+    bool insert(std::uint64_t lineAddress, std::uint64_t readyAt, bool dirty, Entry &displaced)
+    {
+        if (entries == 0)
+            return false;
+        bool full = count == entries;
+        if (full)
+        {
+            displaced = lines[oldest];
+            oldest = (oldest + 1) % entries;
+            count--;
+        }
+        lines[(oldest + count) % entries] = {lineAddress, readyAt, dirty};
+        count++;
+        return full;
+    }
+
+    // remove the line, false if it is not here
+    bool take(std::uint64_t lineAddress, std::uint64_t &readyAt, bool &dirty)
+    {
+        std::size_t i = find(lineAddress);
+        if (i == count)
+            return false;
+        readyAt = slot(i).readyAt;
+        dirty = slot(i).dirty;
+
+        // close the gap so the rest stay in arrival order
+        for (; i + 1 < count; ++i)
+            slot(i) = slot(i + 1);
+        count--;
+        return true;
+    }
+
+    // drop a line that has been written or invalidated below it, true if
+    // it was here and dirty
+    bool invalidate(std::uint64_t lineAddress)
+    {
+        std::uint64_t readyAt;
+        bool dirty = false;
+        return take(lineAddress, readyAt, dirty) && dirty;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(entries, lines, oldest, count);
+    }
+
+private:
+    // the ith line in arrival order
+    Entry &slot(std::size_t i) { return lines[(oldest + i) % entries]; }
+    const Entry &slot(std::size_t i) const { return lines[(oldest + i) % entries]; }
+
+    // arrival position of the line, count if it is not here
+    std::size_t find(std::uint64_t lineAddress) const
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (slot(i).address == lineAddress)
+                return i;
+        }
+        return count;
+    }
+
+    std::size_t entries = 0;
+    std::vector<Entry> lines;
+    std::size_t oldest = 0;
+    std::size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,318 @@
+// Replacement policies for the Cache template.
+//
+// A policy is a class template over the cache geometry, picked at compile
+// time so every call below is inlined into the cache lookup. Each one keeps
+// its own per-set state and provides:
+//   touch(index, way)   a hit on the way
+//   insert(index, way)  the way was just filled
+//   victim(index)       way to evict from a full set
+//   isMRU(index, way)   whether the way is the most recently used one
+// Invalid ways are always filled first by the cache itself.
+
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// true LRU with one age counter per way, age 0 is the most recently used
+template <std::size_t Sets, std::size_t Ways>
+class LRUPolicy
+{
+public:
+    static const char *name() { return "lru"; }
+
+    LRUPolicy() : ages(Sets)
+    {
+        for (std::array<std::uint8_t, Ways> &set : ages)
+            set.fill(Ways - 1);
+    }
+
+    void touch(std::size_t index, int way)
+    {
+        std::array<std::uint8_t, Ways> &age = ages[index];
+        std::uint8_t current = age[way];
+        for (std::size_t i = 0; i < Ways; ++i)
+            age[i] += age[i] < current;
+        age[way] = 0;
+    }
+
+    void insert(std::size_t index, int way)
+    {
+        touch(index, way);
+    }
+
+    int victim(std::size_t index) const
+    {
+        const std::array<std::uint8_t, Ways> &age = ages[index];
+        int oldest = 0;
+        for (std::size_t i = 1; i < Ways; ++i)
+        {
+            if (age[i] > age[oldest])
+                oldest = int(i);
+        }
+        return oldest;
+    }
+
+    bool isMRU(std::size_t index, int way) const
+    {
+        return ages[index][way] == 0;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(ages);
+    }
+
+private:
+    std::vector<std::array<std::uint8_t, Ways>> ages;
+};
+
+// tree pseudo-LRU, Ways - 1 bits per set, each pointing to the colder half
+template <std::size_t Sets, std::size_t Ways>
+class TreePLRUPolicy
+{
+public:
+    static_assert((Ways & (Ways - 1)) == 0, "tree PLRU needs a power of two associativity");
+
+    static const char *name() { return "plru"; }
+
+    TreePLRUPolicy() : trees(Sets, 0), touched(Sets, 0) {}
+
+    void touch(std::size_t index, int way)
+    {
+        std::uint64_t tree = trees[index];
+        std::size_t node = 1;
+        for (std::size_t level = Ways >> 1; level > 0; level >>= 1)
+        {
+            std::uint64_t right = (std::size_t(way) & level) != 0;
+            // point away from the half that was just used
+            tree = (tree & ~(std::uint64_t(1) << node)) | ((right ^ 1) << node);
+            node = node * 2 + right;
+        }
+        trees[index] = tree;
+        touched[index] = 1;
+    }
+
+    void insert(std::size_t index, int way)
+    {
+        touch(index, way);
+    }
+
+    int victim(std::size_t index) const
+    {
+        std::uint64_t tree = trees[index];
+        std::size_t node = 1;
+        int way = 0;
+        for (std::size_t level = Ways >> 1; level > 0; level >>= 1)
+        {
+            std::uint64_t right = (tree >> node) & 1;
+            way = int(way * 2 + right);
+            node = node * 2 + right;
+        }
+        return way;
+    }
+
+    // the way reached by following every bit the other way
+    bool isMRU(std::size_t index, int way) const
+    {
+        std::uint64_t tree = ~trees[index];
+        std::size_t node = 1;
+        int mru = 0;
+        for (std::size_t level = Ways >> 1; level > 0; level >>= 1)
+        {
+            std::uint64_t right = (tree >> node) & 1;
+            mru = int(mru * 2 + right);
+            node = node * 2 + right;
+        }
+        return touched[index] && mru == way;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(trees, touched);
+    }
+
+private:
+    std::vector<std::uint64_t> trees; // bit n is tree node n, root at 1
+    std::vector<std::uint8_t> touched;
+};
+
+// re-reference interval prediction with 2 bit RRPVs (Jaleel et al.).
+// SRRIP inserts with a long re-reference interval, BRRIP with a distant one
+// except for every 32nd fill.
+template <std::size_t Sets, std::size_t Ways, bool Bimodal>
+class RRIPPolicy
+{
+public:
+    static constexpr std::uint8_t MAX_RRPV = 3;
+
+    RRIPPolicy() : rrpv(Sets)
+    {
+        for (std::array<std::uint8_t, Ways> &set : rrpv)
+            set.fill(MAX_RRPV);
+    }
+
+    void touch(std::size_t index, int way)
+    {
+        rrpv[index][way] = 0;
+    }
+
+    void insert(std::size_t index, int way)
+    {
+        if (Bimodal && (++fills & 31) != 0)
+            rrpv[index][way] = MAX_RRPV;
+        else
+            rrpv[index][way] = MAX_RRPV - 1;
+    }
+
+    // first way predicted for distant reuse, ageing the whole set until one is
+    int victim(std::size_t index)
+    {
+        std::array<std::uint8_t, Ways> &set = rrpv[index];
+        std::uint8_t oldest = 0;
+        for (std::size_t i = 0; i < Ways; ++i)
+        {
+            if (set[i] > oldest)
+                oldest = set[i];
+        }
+        std::uint8_t ageing = MAX_RRPV - oldest;
+        int way = -1;
+        for (std::size_t i = 0; i < Ways; ++i)
+        {
+            set[i] += ageing;
+            if (way == -1 && set[i] == MAX_RRPV)
+                way = int(i);
+        }
+        return way;
+    }
+
+    bool isMRU(std::size_t index, int way) const
+    {
+        return rrpv[index][way] == 0;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(rrpv, fills);
+    }
+
+private:
+    std::vector<std::array<std::uint8_t, Ways>> rrpv;
+    std::uint32_t fills = 0;
+};
+
+template <std::size_t Sets, std::size_t Ways>
+class SRRIPPolicy : public RRIPPolicy<Sets, Ways, false>
+{
+public:
+    static const char *name() { return "srrip"; }
+};
+
+template <std::size_t Sets, std::size_t Ways>
+class BRRIPPolicy : public RRIPPolicy<Sets, Ways, true>
+{
+public:
+    static const char *name() { return "brrip"; }
+};
+
+// first in first out, hits do not change the order. Each way keeps its
+// fill age, 0 for the newest, so a way refilled after an invalidation
+// becomes the newest instead of keeping its old turn.
+template <std::size_t Sets, std::size_t Ways>
+class FIFOPolicy
+{
+public:
+    static const char *name() { return "fifo"; }
+
+    FIFOPolicy() : ages(Sets), filled(Sets, 0)
+    {
+        for (std::array<std::uint8_t, Ways> &set : ages)
+            set.fill(Ways - 1);
+    }
+
+    void touch(std::size_t, int) {}
+
+    void insert(std::size_t index, int way)
+    {
+        std::array<std::uint8_t, Ways> &age = ages[index];
+        std::uint8_t current = age[way];
+        for (std::size_t i = 0; i < Ways; ++i)
+            age[i] += age[i] < current;
+        age[way] = 0;
+        filled[index] = 1;
+    }
+
+    int victim(std::size_t index) const
+    {
+        const std::array<std::uint8_t, Ways> &age = ages[index];
+        int oldest = 0;
+        for (std::size_t i = 1; i < Ways; ++i)
+        {
+            if (age[i] > age[oldest])
+                oldest = int(i);
+        }
+        return oldest;
+    }
+
+    bool isMRU(std::size_t index, int way) const
+    {
+        return filled[index] && ages[index][way] == 0;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(ages, filled);
+    }
+
+private:
+    std::vector<std::array<std::uint8_t, Ways>> ages;
+    std::vector<std::uint8_t> filled;
+};
+
+// uniform random victim from a fixed seed, so runs are repeatable
+template <std::size_t Sets, std::size_t Ways>
+class RandomPolicy
+{
+public:
+    static const char *name() { return "random"; }
+
+    void touch(std::size_t, int) {}
+    void insert(std::size_t, int) {}
+
+    int victim(std::size_t)
+    {
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return int(state % Ways);
+    }
+
+    bool isMRU(std::size_t, int) const
+    {
+        return false;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(state);
+    }
+
+private:
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+};
+
+#endif
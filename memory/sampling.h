@@ -0,0 +1,150 @@
+// Sampled simulation of long traces.
+//
+// Set sampling simulates only the sets whose index is phase modulo the set
+// period, so a cache sees 1/period of the references, and its miss ratio
+// stands for the whole cache's. Because the index is the line address modulo
+// a power of two set count, a period that divides the set count selects the
+// same lines for every cache with that line size, and the trace can be
+// filtered once per line size before any cache runs.
+//
+// Time sampling keeps, of every timePeriod references, the last warmup plus
+// detail of them: the warmup references only bring the cache back to a
+// realistic state after the skipped stretch and the detail references are
+// measured.
+//
+// Estimates come with a 95% confidence interval from the ratio estimator of
+// a cluster sample, the clusters being the windows when sampling in time and
+// the sampled sets otherwise. When both are on, the windows are the clusters
+// and the set sample inside each window is taken as given.
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "decode.h"
+
+struct SamplingConfig
+{
+    // keep the sets whose index is setPhase modulo setPeriod, a power of
+    // two; every set when 1
+    std::size_t setPeriod = 1;
+    std::size_t setPhase = 0;
+
+    // of every timePeriod references skip the first, warm with the next
+    // warmup and measure the last detail; every reference when 0
+    std::size_t timePeriod = 0;
+    std::size_t detail = 0;
+    std::size_t warmup = 0;
+
+    bool setSampled() const { return setPeriod > 1; }
+    bool timeSampled() const { return timePeriod > 0; }
+
+    // share of a cluster population the sample covers
+    double fraction() const
+    {
+        return timeSampled() ? double(detail) / timePeriod : 1.0 / setPeriod;
+    }
+};
+
+// accesses [begin, measureFrom) of a window only warm the cache, the ones
+// in [measureFrom, end) are counted
+struct TraceWindow
+{
+    std::size_t begin;
+    std::size_t measureFrom;
+    std::size_t end;
+};
+
+struct SampledTrace
+{
+    std::vector<Access> accesses;
+    std::vector<TraceWindow> windows;
+    bool timeSampled = false;
+};
+
+// the windows of the trace for the time sampling, keeping only the lines of
+// the sampled sets unless lineBytes is 0
+inline SampledTrace sampleTrace(const std::vector<Access> &trace, const SamplingConfig &config, std::size_t lineBytes)
+{
+    SampledTrace sampled;
+    sampled.timeSampled = config.timeSampled();
+    std::size_t period = config.timeSampled() ? config.timePeriod : trace.size();
+    std::size_t kept = config.timeSampled() ? config.warmup + config.detail : trace.size();
+    std::uint64_t setMask = config.setPeriod - 1;
+
+    for (std::size_t start = 0; start < trace.size(); start += period)
+    {
+        std::size_t end = start + period < trace.size() ? start + period : trace.size();
+        std::size_t from = end - start > kept ? end - kept : start;
+        std::size_t measure = end - start > config.detail && config.timeSampled() ? end - config.detail : from;
+
+        TraceWindow window = {sampled.accesses.size(), 0, 0};
+        for (std::size_t i = from; i < end; ++i)
+        {
+            if (i == measure)
+                window.measureFrom = sampled.accesses.size();
+            if (lineBytes == 0 || ((trace[i].address / lineBytes) & setMask) == config.setPhase)
+                sampled.accesses.push_back(trace[i]);
+        }
+        if (measure == end)
+            window.measureFrom = sampled.accesses.size();
+        window.end = sampled.accesses.size();
+        sampled.windows.push_back(window);
+    }
+    return sampled;
+}
+
+// counts of one cluster
+struct SampleUnit
+{
+    std::uint64_t accesses = 0;
+    std::uint64_t misses = 0;
+};
+
+struct RatioEstimate
+{
+    double ratio = 0;
+    double halfWidth = 0; // of the 95% interval, NaN with fewer than two units,
+                          // which callers show as n/a
+};
+
+// misses over accesses summed over the units, with the variance of the
+// ratio estimator and the finite population correction for the fraction of
+// the population the units cover
+inline RatioEstimate estimateRatio(const std::vector<SampleUnit> &units, double fraction)
+{
+    RatioEstimate estimate;
+    double accesses = 0, misses = 0;
+    for (const SampleUnit &unit : units)
+    {
+        accesses += double(unit.accesses);
+        misses += double(unit.misses);
+    }
+    if (accesses == 0)
+        return estimate;
+    estimate.ratio = misses / accesses;
+
+    std::size_t n = units.size();
+    if (n < 2)
+    {
+        estimate.halfWidth = std::numeric_limits<double>::quiet_NaN();
+        return estimate;
+    }
+    double squares = 0;
+    for (const SampleUnit &unit : units)
+    {
+        double residual = double(unit.misses) - estimate.ratio * double(unit.accesses);
+        squares += residual * residual;
+    }
+    double mean = accesses / n;
+    double correction = fraction < 1 ? 1 - fraction : 0;
+    double variance = correction * squares / (n - 1) / (n * mean * mean);
+    estimate.halfWidth = 1.96 * std::sqrt(variance);
+    return estimate;
+}
+
+#endif
@@ -0,0 +1,813 @@
+// Reentrant cache simulator.
+//
+// CacheSimulator owns everything one simulation needs: the L1 and its
+// data, the optional L2 and LLC, main memory, the write buffer, prefetcher,
+// TLB, timing model, statistics and the replay register file. Instances
+// share nothing, so a process can run as many as it likes, one per thread.
+// The access path does not allocate beyond the pages and tracking tables
+// that grow on first touch.
+//
+// The geometry of the L1, L2 and LLC, address width included, is fixed at
+// compile time by the Cache types BasicCacheSimulator is built from;
+// everything else is set at run time through SimulatorConfig. The default
+// CacheSimulator sees whole 64 bit addresses, and a simulator built with a
+// narrower width rejects addresses past it instead of folding them into
+// its caches. With translation on, the page tables take the top of the
+// address space by default and data addresses there are rejected too, so
+// walks never share lines with the trace. Per access "lw hit" style lines
+// go to the log stream when one is given.
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "backing_store.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "decode.h"
+#include "hierarchy.h"
+#include "prefetch.h"
+#include "stats.h"
+#include "timing.h"
+#include "tlb.h"
+#include "write_policy.h"
+
+struct SimulatorConfig
+{
+    // lower cache levels between the L1 and main memory
+    bool useHierarchy = false;
+    Inclusion l2Inclusion = Inclusion::NINE;
+    Inclusion l3Inclusion = Inclusion::NINE;
+
+    // write hits are written back on eviction and write misses go straight
+    // to memory by default; a write buffer of 0 entries passes writes through
+    WritePolicy writePolicy = WritePolicy::WriteBack;
+    WriteMiss writeMiss = WriteMiss::NoAllocate;
+    std::size_t writeBufferEntries = 0;
+
+    // prefetched lines go into the cache, or into a buffer beside it when it
+    // has entries, and arrive prefetchLatency accesses after they are issued;
+    // either way their fills take MSHRs in the timing model
+    PrefetchKind prefetchKind = PrefetchKind::None;
+    unsigned prefetchDegree = 2;
+    std::size_t prefetchBufferEntries = 0;
+    unsigned prefetchLatency = 4;
+
+    // latencies of an L1 hit and of the L2, LLC and memory, and the MSHRs
+    unsigned levelLatency[4] = {1, 10, 30, 100};
+    std::size_t mshrs = 8;
+
+    // address translation; page tables fill the top of the address space
+    // unless mmu.tableBase places them, and data there is out of range
+    bool useTLB = false;
+    MmuConfig mmu;
+
+    // split misses after the first reference into capacity and conflict
+    // ones, counted in the summary and printed in the log; off, no shadow
+    // cache is kept and only compulsory misses are told apart
+    bool classifyMisses = false;
+
+    // per access output, none when null
+    std::ostream *log = nullptr;
+
+    // value of a word never written, every word starts out as its word
+    // address plus 5
+    PagedMemory::Initializer memoryInitializer = [](std::uint64_t address) { return int(address) + 5; };
+};
+
+// L1:  the first level, 16 one word blocks in 2 ways by default
+// L2:  the optional second level, 8 sets of 4 ways of L1 sized lines
+// LLC: the optional last level, 16 sets of 4 ways
+// The lower levels share the L1's address width and hold whole L1 lines.
+template <class L1 = Cache<8, 2, 4, 64>, class L2 = Cache<8, 4, L1::LINE_BYTES, L1::ADDR_BITS>,
+          class LLC = Cache<16, 4, L1::LINE_BYTES, L1::ADDR_BITS>>
+class BasicCacheSimulator
+{
+public:
+    using L1Cache = L1;
+    using L2Cache = L2;
+    using L3Cache = LLC;
+
+    static constexpr std::size_t LINE_BYTES = L1Cache::LINE_BYTES;
+    static constexpr unsigned ADDR_BITS = L1Cache::ADDR_BITS;
+
+    static_assert(L1Cache::WORDS_PER_LINE <= 64, "word use is tracked in 64 bits");
+    static_assert(L2Cache::ADDR_BITS == ADDR_BITS && L3Cache::ADDR_BITS == ADDR_BITS, "every level sees the same addresses");
+    static_assert(L2Cache::LINE_BYTES >= LINE_BYTES && L3Cache::LINE_BYTES >= LINE_BYTES, "lower levels hold whole L1 lines");
+
+    explicit BasicCacheSimulator(const SimulatorConfig &simConfig = SimulatorConfig())
+        : config(simConfig), writeBuffer(simConfig.writeBufferEntries, LINE_BYTES),
+          stats({L1Cache::SETS, L1Cache::WAYS, L1Cache::LINE_BYTES, simConfig.classifyMisses})
+    {
+        lowerLevels.configure("L2", config.l2Inclusion);
+        lowerLevels.next().configure("LLC", config.l3Inclusion);
+        prefetcher.configure(config.prefetchKind, LINE_BYTES, config.prefetchDegree);
+        prefetchBuffer.configure(config.prefetchBufferEntries);
+        timing.configure({config.levelLatency[0], config.mshrs});
+        if (config.mmu.tableBase == MmuConfig::TABLES_AT_TOP)
+            config.mmu.tableBase = topTableBase();
+        mmu.configure(config.mmu);
+        memory.setInitializer(config.memoryInitializer);
+    }
+
+    // whether the byte address is within the simulated address width
+    static bool inRange(std::uint64_t address)
+    {
+        return (address & ~lowMask(ADDR_BITS)) == 0;
+    }
+
+    // bytes of every page table a walk can reach. One table at a level
+    // spans 12 + 9 * level address bits.
+    static constexpr std::uint64_t tableBytes()
+    {
+        std::uint64_t tables = 0;
+        for (unsigned level = 1; level <= PageTable::LEVELS; ++level)
+        {
+            unsigned spanned = 12 + PageTable::INDEX_BITS * level;
+            tables += spanned >= ADDR_BITS ? 1 : std::uint64_t(1) << (ADDR_BITS - spanned);
+        }
+        return tables * PageTable::TABLE_BYTES;
+    }
+
+    // the default table pool, the top tableBytes of the address width, or
+    // just past it when the width is too narrow to hold them
+    static constexpr std::uint64_t topTableBase()
+    {
+        return tableBytes() > lowMask(ADDR_BITS) ? lowMask(ADDR_BITS) + 1 : lowMask(ADDR_BITS) - tableBytes() + 1;
+    }
+
+    // whether every page table a walk can reach lies within the address
+    // width, so that walks go through the caches; the pool is filled from
+    // tableBase up
+    static bool tablesInRange(const MmuConfig &mmu)
+    {
+        std::uint64_t last = mmu.tableBase + tableBytes() - 1;
+        return inRange(mmu.tableBase) && last > mmu.tableBase && inRange(last);
+    }
+
+    // whether data may live at the byte address: within the address width
+    // and, with translation on, outside the page tables
+    bool isDataAddress(std::uint64_t address) const
+    {
+        return inRange(address) && !(config.useTLB && address - config.mmu.tableBase < tableBytes());
+    }
+
+    // one load or store without a register; a store writes value. False,
+    // changing nothing, if the address is out of range or in the page
+    // tables.
+    bool access(std::uint64_t address, bool isWrite, int value = 0)
+    {
+        if (isWrite)
+            return store(address, value);
+        int loaded;
+        return load(address, loaded);
+    }
+
+    // replayed lw and sw records, loading into and storing from the $s
+    // registers they name. Returns the records run, fewer than count when
+    // one has an address out of range.
+    std::size_t access(const Access *records, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!execute(records[i]))
+                return i;
+        }
+        return count;
+    }
+
+    bool execute(const Access &record)
+    {
+        int &reg = registers[record.reg & 7];
+        if (record.isWrite)
+            return store(record.address, reg, OPCODE_SW, record.reg);
+        return load(record.address, reg, OPCODE_LW, record.reg);
+    }
+
+    // load the word at the byte address into value, false if the address is
+    // out of range or in the page tables. The opcode and rt of the
+    // instruction stand in for its program counter in the prefetcher.
+    bool load(std::uint64_t address, int &value, unsigned opcode = OPCODE_LW, unsigned rt = 0)
+    {
+        if (!isDataAddress(address))
+            return false;
+        translate(address);
+        std::size_t index = L1Cache::getIndex(address);
+        accessCount++;
+
+        // Check if the data is in the cache, or waiting in the prefetch buffer
+        int block = cache.lookup(index, L1Cache::getTag(address));
+        if (block == -1)
+            block = takePrefetched(index, address);
+
+        MissClass missClass = stats.access(false, block != -1, index, address >> L1Cache::OFFSET_BITS);
+        bool hit = block != -1;
+        bool firstUse = false;
+        if (hit)
+        {
+            // update history bits, and read the word
+            if (config.log)
+                *config.log << "lw hit\n";
+            eventLog.record(EventType::LoadHit, address);
+            firstUse = usePrefetch(index, block);
+            useWord(index, block, address);
+            cache.updateHistory(index, block);
+        }
+        else
+        {
+            logMiss("lw", missClass);
+            eventLog.record(EventType::LoadMiss, address);
+            block = allocateLine(index, address);
+        }
+        value = cacheData.line(index, block)[L1Cache::getWord(address)];
+        timing.access(address >> L1Cache::OFFSET_BITS, hit, !hit, lastFillLatency);
+
+        // a load/store trace has no program counter, the instruction without
+        // its immediate stands in for it
+        prefetchAfter((opcode << 5) | rt, address, !hit || firstUse);
+        return true;
+    }
+
+    // store the word at the byte address, false if it is out of range or in
+    // the page tables
+    bool store(std::uint64_t address, int value, unsigned opcode = OPCODE_SW, unsigned rt = 0)
+    {
+        if (!isDataAddress(address))
+            return false;
+        translate(address);
+        std::size_t index = L1Cache::getIndex(address);
+        accessCount++;
+
+        // Check if the data is in the cache, or waiting in the prefetch buffer
+        int block = cache.lookup(index, L1Cache::getTag(address));
+        if (block == -1)
+            block = takePrefetched(index, address);
+
+        MissClass missClass = stats.access(true, block != -1, index, address >> L1Cache::OFFSET_BITS);
+        bool hit = block != -1;
+        bool firstUse = false;
+        if (hit)
+        {
+            // update history bits, and write to cache
+            if (config.log)
+                *config.log << "sw hit\n";
+            eventLog.record(EventType::StoreHit, address);
+            firstUse = usePrefetch(index, block);
+            useWord(index, block, address);
+            cache.updateHistory(index, block);
+        }
+        else
+        {
+            logMiss("sw", missClass);
+            eventLog.record(EventType::StoreMiss, address);
+            if (config.writeMiss == WriteMiss::Allocate)
+                block = allocateLine(index, address);
+        }
+
+        if (block == -1)
+        {
+            // write directly to memory, posted without waiting
+            writeThrough(address, value);
+            timing.access(address >> L1Cache::OFFSET_BITS, false, false, 0);
+        }
+        else
+        {
+            timing.access(address >> L1Cache::OFFSET_BITS, hit, !hit, lastFillLatency);
+            cacheData.line(index, block)[L1Cache::getWord(address)] = value;
+            if (config.writePolicy == WritePolicy::WriteBack)
+                cache.setDirty(index, block);
+            else
+                writeThrough(address, value);
+        }
+
+        prefetchAfter((opcode << 5) | rt, address, !hit || firstUse);
+        return true;
+    }
+
+    // the word at the byte address as a load would see it, without counting
+    // an access or changing any state; 0 if the address is out of range
+    int peek(std::uint64_t address) const
+    {
+        if (!inRange(address))
+            return 0;
+        std::size_t index = L1Cache::getIndex(address);
+        int block = cache.lookup(index, L1Cache::getTag(address));
+        if (block != -1)
+            return cacheData.line(index, block)[L1Cache::getWord(address)];
+        return memory.read(getAddress(address));
+    }
+
+    // drain the write buffer at the end of a run
+    void flush()
+    {
+        stats.writeTraffic(writeBuffer.drain());
+        stats.coalescedWrites = writeBuffer.coalesced;
+    }
+
+    // write a checkpoint of the whole simulation, with the position in the
+    // trace it was taken at
+    bool save(std::ostream &out, std::uint64_t traceOffset) const
+    {
+        CheckpointWriter writer(out, shape());
+        writer(traceOffset);
+        const_cast<BasicCacheSimulator *>(this)->transfer(writer);
+        return writer.good();
+    }
+
+    // replace the state with a checkpoint taken by a build of the same
+    // shape, configuration included; false, leaving the state undefined,
+    // if it cannot be read
+    bool restore(std::istream &in, std::uint64_t &traceOffset)
+    {
+        CheckpointReader reader(in, shape());
+        if (!reader.good())
+            return false;
+        reader(traceOffset);
+        transfer(reader);
+        return reader.good();
+    }
+
+    // zero every statistic, keeping the state of the caches, buffers and
+    // TLBs, at the end of a warmup or the start of a region of interest
+    void resetStatistics()
+    {
+        stats.resetCounters();
+        timing.resetCounters();
+        lowerLevels.resetCounters();
+        mmu.resetCounters();
+        writeBuffer.resetCounters();
+    }
+
+    int reg(int index) const { return registers[index & 7]; }
+    const Stats &statistics() const { return stats; }
+    const Timing &timingModel() const { return timing; }
+    const Mmu &translation() const { return mmu; }
+    const SimulatorConfig &getConfig() const { return config; }
+    const EventLog<SIM_EVENT_LOG> &events() const { return eventLog; }
+
+    // the summary with the timing and, when on, translation fields
+    void writeJSON(std::ostream &out) const
+    {
+        if (config.useTLB)
+            stats.writeJSON(out, bothFields(timing, mmu));
+        else
+            stats.writeJSON(out, timing);
+    }
+
+    void writeCSV(std::ostream &out) const
+    {
+        if (config.useTLB)
+            stats.writeCSV(out, bothFields(timing, mmu));
+        else
+            stats.writeCSV(out, timing);
+    }
+
+    void displayRegisters(std::ostream &out) const
+    {
+        out << "Registers" << std::endl;
+        for (int i = 0; i < 8; ++i)
+        {
+            std::bitset<32> reg(registers[i]);
+            out << "$s" << i << ": " << reg << std::endl;
+        }
+        out << std::endl;
+    }
+
+    // the sets of every way, invalid blocks shown as zeroes unless
+    // printZeroes is false
+    void displayCache(std::ostream &out, bool printZeroes = true) const
+    {
+        for (std::size_t i = 0; i < L1Cache::WAYS; i++)
+        {
+            out << "Cache Block " << i << std::endl;
+            out << "Set#\tValid\tHist\tTag\tData" << std::endl;
+            for (std::size_t j = 0; j < L1Cache::SETS; ++j)
+            {
+                const int *line = cacheData.line(j, int(i));
+                bool history = cache.isMRU(j, int(i));
+
+                out << j << "\t";
+                if (cache.isValid(j, int(i)))
+                {
+                    out << "1\t";
+                    out << history << "\t";
+                    out << std::bitset<L1Cache::TAG_BITS>(cache.getTag(j, int(i))) << "\t";
+                    for (std::size_t w = 0; w < L1Cache::WORDS_PER_LINE; ++w)
+                        out << (w ? " " : "") << std::bitset<32>(line[w]);
+                    out << std::endl;
+                }
+                else if (printZeroes)
+                {
+                    out << "0\t" << (history ? "1\t" : "0\t");
+                    out << std::bitset<L1Cache::TAG_BITS>(0) << "\t";
+                    for (std::size_t w = 0; w < L1Cache::WORDS_PER_LINE; ++w)
+                        out << (w ? " " : "") << std::bitset<32>(0);
+                    out << std::endl;
+                }
+                else
+                {
+                    out << "0\t" << (history ? "1\t" : "0\t") << std::endl;
+                }
+            }
+            out << std::endl;
+        }
+    }
+
+    // the first words of main memory
+    void displayMemory(std::ostream &out, int words = 128) const
+    {
+        out << "Addr\tData" << std::endl;
+        for (int i = 0; i < words; ++i)
+        {
+            std::bitset<32> mem(memory.read(i));
+            out << i << ":\t" << mem << std::endl;
+        }
+        out << std::endl;
+    }
+
+    // per level statistics of the cache hierarchy
+    void displayHierarchy(std::ostream &out) const
+    {
+        out << "Level\tMode\tReads\tHits\tWrites\tHits\tWB in\tEvict\tDirty\tBack inv" << std::endl;
+        auto displayLevel = [&out](const char *name, const char *mode, const LevelStats &level)
+        {
+            out << name << "\t" << mode << "\t" << level.reads << "\t" << level.readHits << "\t"
+                << level.writes << "\t" << level.writeHits << "\t" << level.writebacksIn << "\t" << level.evictions << "\t"
+                << level.dirtyEvictions << "\t" << level.backInvalidations << std::endl;
+        };
+        LevelStats l1Stats;
+        l1Stats.reads = stats.loadHits + stats.loadMisses;
+        l1Stats.readHits = stats.loadHits;
+        l1Stats.writes = stats.storeHits + stats.storeMisses;
+        l1Stats.writeHits = stats.storeHits;
+        l1Stats.evictions = stats.evictions;
+        l1Stats.dirtyEvictions = stats.writebacks;
+        displayLevel("L1", "-", l1Stats);
+        lowerLevels.forEachLevel([&](const char *name, Inclusion inclusion, const LevelStats &level)
+                                 { displayLevel(name, inclusionName(inclusion), level); });
+        out << std::endl;
+    }
+
+    // timing summary
+    void displayTiming(std::ostream &out) const
+    {
+        out << "Cycles\tAMAT\tMLP\tFills\tMerged\tStalls" << std::endl;
+        out << timing.cycles() << "\t" << timing.amat() << "\t" << timing.mlp() << "\t" << timing.fills << "\t"
+            << timing.merged << "\t" << timing.stallCycles << std::endl;
+        out << std::endl;
+    }
+
+    // translation summary
+    void displayTLB(std::ostream &out) const
+    {
+        out << "Pages\tdTLB\tReach\tsTLB\tReach\tdTLB hit\tsTLB hit\tWalks\tRefs\tCycles\tTables" << std::endl;
+        out << pageSizeName(config.mmu.pageSize) << "\t" << mmu.l1.getConfig().entries << "x" << mmu.l1.getConfig().ways << "\t"
+            << mmu.reach(mmu.l1) << "\t" << mmu.l2.getConfig().entries << "x" << mmu.l2.getConfig().ways << "\t"
+            << mmu.reach(mmu.l2) << "\t" << mmu.l1Hits << "\t" << mmu.l2Hits << "\t" << mmu.walks << "\t"
+            << mmu.walkReferences << "\t" << mmu.walkCycles << "\t" << mmu.tablePages() << std::endl;
+        out << std::endl;
+    }
+
+private:
+    // prefetched blocks that have not been used yet
+    struct PrefetchedBlock
+    {
+        bool unused = false;
+        std::uint64_t readyAt = 0; // access count the line arrives at
+    };
+
+    // converts the byte address to a word address
+    static std::uint64_t getAddress(std::uint64_t address)
+    {
+        return address >> 2;
+    }
+
+    // the build a checkpoint belongs to: cache geometry and compiled-in
+    // models
+    static std::string shape()
+    {
+        return "l1 " + geometry<L1Cache>() + " l2 " + geometry<L2Cache>() + " llc " + geometry<L3Cache>() + " addr " +
+               std::to_string(ADDR_BITS) + " stats " + std::to_string(Stats::ENABLED) + " timing " +
+               std::to_string(Timing::ENABLED) + " events " + std::to_string(SIM_EVENT_LOG);
+    }
+
+    template <class CacheType>
+    static std::string geometry()
+    {
+        return std::to_string(CacheType::SETS) + "x" + std::to_string(CacheType::WAYS) + "x" +
+               std::to_string(CacheType::LINE_BYTES);
+    }
+
+    // every field of the run but the log stream and memory initializer,
+    // which belong to the process that restores it
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(config.useHierarchy, config.l2Inclusion, config.l3Inclusion, config.writePolicy, config.writeMiss,
+                config.writeBufferEntries, config.prefetchKind, config.prefetchDegree, config.prefetchBufferEntries,
+                config.prefetchLatency, config.levelLatency, config.mshrs, config.useTLB, config.mmu,
+                config.classifyMisses);
+        archive(registers, cache, cacheData, usedWords, prefetched, lowerLevels, writeBuffer, prefetcher, prefetchBuffer,
+                accessCount, timing, lastFillLatency, mmu, stats, eventLog, memory);
+    }
+
+    void logMiss(const char *op, MissClass missClass)
+    {
+        if (!config.log)
+            return;
+        if (config.classifyMisses)
+            *config.log << op << " miss " << missClassName(missClass) << "\n";
+        else
+            *config.log << op << " miss\n";
+    }
+
+    // read the line holding the address from the lower levels, which may
+    // back-invalidate, setting lastFillLatency. dirty is set when an
+    // exclusive level hands up a modified line.
+    void fetchLine(std::uint64_t address, bool &dirty)
+    {
+        dirty = false;
+        lastFillLatency = config.levelLatency[3];
+        stats.readTraffic(L1Cache::LINE_BYTES);
+        if (!config.useHierarchy)
+            return;
+
+        BackInvalidations invalidations;
+        std::size_t servedBy = 0;
+        lowerLevels.read(address, invalidations, dirty, &servedBy);
+        backInvalidate(invalidations);
+
+        // the L2 and LLC latencies down to the level that held the line
+        std::size_t levels = lowerLevels.LEVELS;
+        lastFillLatency = 0;
+        for (std::size_t level = 1; level <= levels && level <= levels - servedBy + 1; ++level)
+            lastFillLatency += config.levelLatency[level];
+        if (servedBy == 0)
+            lastFillLatency += config.levelLatency[3];
+    }
+
+    // bring the line holding the address into the set, returning its way.
+    // fetch is false when the line was already read by a prefetch.
+    int allocateLine(std::size_t index, std::uint64_t address, bool fetch = true)
+    {
+        bool dirty = false;
+        if (fetch)
+            fetchLine(address, dirty);
+
+        // select the victim block
+        int block = cache.findVictim(index);
+        int *line = cacheData.line(index, block);
+
+        // if the block is valid, drop it, writing the whole line back if dirty
+        if (cache.isValid(index, block))
+        {
+            stats.eviction();
+            stats.lineUse(__builtin_popcountll(usedWords[index * L1Cache::WAYS + block]));
+            eventLog.record(EventType::Eviction, L1Cache::getBlockAddress(index, cache.getTag(index, block)));
+            if (config.useHierarchy)
+            {
+                BackInvalidations invalidations;
+                typename L1Cache::Address victim = L1Cache::getBlockAddress(index, cache.getTag(index, block));
+                lowerLevels.evicted(victim, cache.isDirty(index, block), invalidations);
+                backInvalidate(invalidations);
+            }
+            if (cache.isDirty(index, block))
+                writeBackBlock(index, block);
+        }
+
+        // fill the whole line, then set tag, valid and history bits
+        std::uint64_t fillAddress = getAddress(address) & ~std::uint64_t(L1Cache::WORDS_PER_LINE - 1);
+        for (std::size_t i = 0; i < L1Cache::WORDS_PER_LINE; ++i)
+            line[i] = memory.read(fillAddress + i);
+        cache.fill(index, block, L1Cache::getTag(address));
+        usedWords[index * L1Cache::WAYS + block] = std::uint64_t(1) << L1Cache::getWord(address);
+        prefetched[index * L1Cache::WAYS + block] = PrefetchedBlock();
+        if (dirty)
+            cache.setDirty(index, block);
+        return block;
+    }
+
+    // move the line from the prefetch buffer into the cache as an unused
+    // prefetched block, keeping its dirty bit, -1 if the buffer does not
+    // hold it
+    int takePrefetched(std::size_t index, std::uint64_t address)
+    {
+        std::uint64_t readyAt;
+        bool dirty = false;
+        std::uint64_t lineAddress = address & ~std::uint64_t(L1Cache::LINE_BYTES - 1);
+        if (prefetchBuffer.capacity() == 0 || !prefetchBuffer.take(lineAddress, readyAt, dirty))
+            return -1;
+        int block = allocateLine(index, address, false);
+        if (dirty)
+            cache.setDirty(index, block);
+        usedWords[index * L1Cache::WAYS + block] = 0;
+        prefetched[index * L1Cache::WAYS + block] = {true, readyAt};
+        return block;
+    }
+
+    // first demand use of a prefetched block, counted as useful and as late
+    // if the line had not arrived yet. False if the block was not prefetched
+    // or was already used.
+    bool usePrefetch(std::size_t index, int block)
+    {
+        PrefetchedBlock &line = prefetched[index * L1Cache::WAYS + block];
+        if (!line.unused)
+            return false;
+        line.unused = false;
+        stats.prefetchUse(accessCount < line.readyAt);
+        return true;
+    }
+
+    // train the prefetcher on the access and issue the lines it proposes
+    // that are not already cached or buffered
+    void prefetchAfter(std::uint64_t pc, std::uint64_t address, bool trigger)
+    {
+        if (prefetcher.getKind() == PrefetchKind::None)
+            return;
+
+        PrefetchRequests requests;
+        prefetcher.observe(pc, address, trigger, requests);
+        for (int i = 0; i < requests.count; ++i)
+        {
+            // lines past the cache's address range would alias
+            std::uint64_t lineAddress = requests.address[i];
+            if (!isDataAddress(lineAddress))
+                continue;
+            std::size_t index = L1Cache::getIndex(lineAddress);
+            if (cache.lookup(index, L1Cache::getTag(lineAddress)) != -1 || prefetchBuffer.contains(lineAddress))
+                continue;
+
+            // either way the fill takes an MSHR like a demand miss would
+            stats.prefetchIssue();
+            if (prefetchBuffer.capacity())
+            {
+                bool dirty = false;
+                PrefetchBuffer::Entry displaced;
+                fetchLine(lineAddress, dirty);
+                if (prefetchBuffer.insert(lineAddress, accessCount + config.prefetchLatency, dirty, displaced))
+                    releasePrefetched(displaced.address, displaced.dirty);
+            }
+            else
+            {
+                int block = allocateLine(index, lineAddress);
+                usedWords[index * L1Cache::WAYS + block] = 0;
+                prefetched[index * L1Cache::WAYS + block] = {true, accessCount + config.prefetchLatency};
+            }
+            timing.prefetch(lineAddress >> L1Cache::OFFSET_BITS, lastFillLatency);
+        }
+    }
+
+    // a buffered line that leaves unused goes down like an L1 victim,
+    // written back if an exclusive level handed it up dirty
+    void releasePrefetched(std::uint64_t lineAddress, bool dirty)
+    {
+        if (config.useHierarchy)
+        {
+            BackInvalidations invalidations;
+            lowerLevels.evicted(lineAddress, dirty, invalidations);
+            backInvalidate(invalidations);
+        }
+        if (dirty)
+            writeBackLine(lineAddress);
+    }
+
+    // mark the word used, counting the first use of each word the fill
+    // brought in besides the one that missed
+    void useWord(std::size_t index, int block, std::uint64_t address)
+    {
+        std::uint64_t &used = usedWords[index * L1Cache::WAYS + block];
+        std::uint64_t word = std::uint64_t(1) << L1Cache::getWord(address);
+        if (!(used & word))
+            stats.spatialHit();
+        used |= word;
+    }
+
+    // translate the address before the cache lookup. Data pages are mapped
+    // virtual equals physical, so only the TLB and walk cost is added.
+    void translate(std::uint64_t address)
+    {
+        if (!config.useTLB)
+            return;
+        unsigned cycles = 0;
+        mmu.translate(address, cycles, [this](std::uint64_t entryAddress) { return walkRead(entryAddress); });
+        timing.walk(cycles);
+    }
+
+    // one page table entry read of a walk, through the L1 and the levels
+    // below it. Walk references outside the cached address space, which
+    // tablesInRange rules out, go straight to memory. Returns its latency.
+    unsigned walkRead(std::uint64_t entryAddress)
+    {
+        if (!inRange(entryAddress))
+            return config.levelLatency[0] + config.levelLatency[3];
+        std::size_t index = L1Cache::getIndex(entryAddress);
+        int block = cache.lookup(index, L1Cache::getTag(entryAddress));
+        if (block != -1)
+        {
+            cache.updateHistory(index, block);
+            return config.levelLatency[0];
+        }
+        block = allocateLine(index, entryAddress);
+        usedWords[index * L1Cache::WAYS + block] = 0;
+        return config.levelLatency[0] + lastFillLatency;
+    }
+
+    // write the whole line back to memory
+    void writeBackBlock(std::size_t index, int block)
+    {
+        const int *line = cacheData.line(index, block);
+        std::uint64_t writeBackAddress = L1Cache::getBlockAddress(index, cache.getTag(index, block));
+        writeBackLine(writeBackAddress);
+        for (std::size_t i = 0; i < L1Cache::WORDS_PER_LINE; ++i)
+            memory.write((writeBackAddress >> 2) + i, line[i]);
+    }
+
+    // count the writeback of the line at the byte address; a buffered
+    // prefetch has no data apart from memory, so only the traffic is left
+    void writeBackLine(std::uint64_t lineAddress)
+    {
+        stats.writeback();
+        stats.writeTraffic(writeBuffer.write(lineAddress, L1Cache::LINE_BYTES));
+        eventLog.record(EventType::Writeback, lineAddress);
+    }
+
+    // send one word past the cache to the next level
+    void writeThrough(std::uint64_t address, int value)
+    {
+        memory.write(getAddress(address), value);
+        std::uint64_t lineAddress = address & ~std::uint64_t(L1Cache::LINE_BYTES - 1);
+        if (prefetchBuffer.contains(lineAddress))
+        {
+            std::uint64_t readyAt;
+            bool dirty = false;
+            prefetchBuffer.take(lineAddress, readyAt, dirty);
+            releasePrefetched(lineAddress, dirty);
+        }
+        stats.writeTraffic(writeBuffer.write(address & ~std::uint64_t(3), 4));
+        if (config.useHierarchy)
+        {
+            BackInvalidations invalidations;
+            lowerLevels.write(address, invalidations);
+            backInvalidate(invalidations);
+        }
+    }
+
+    // invalidate the lines an inclusive lower level has evicted, in the
+    // cache and in the prefetch buffer beside it
+    void backInvalidate(const BackInvalidations &invalidations)
+    {
+        for (int i = 0; i < invalidations.count; ++i)
+        {
+            for (std::size_t offset = 0; offset < invalidations.bytes[i]; offset += L1Cache::LINE_BYTES)
+            {
+                typename L1Cache::Address address = invalidations.address[i] + offset;
+                if (prefetchBuffer.invalidate(address))
+                    writeBackLine(address);
+                std::size_t index = L1Cache::getIndex(address);
+                int block = cache.lookup(index, L1Cache::getTag(address));
+                if (block == -1)
+                    continue;
+                if (cache.isDirty(index, block))
+                    writeBackBlock(index, block);
+                cache.invalidate(index, block);
+            }
+        }
+    }
+
+    SimulatorConfig config;
+
+    // register file of the replayed $s registers
+    int registers[8] = {0};
+
+    L1Cache cache;
+    LineStore<L1Cache> cacheData;
+    // words of each block used since it was filled, one bit per word
+    std::uint64_t usedWords[L1Cache::BLOCKS] = {0};
+    PrefetchedBlock prefetched[L1Cache::BLOCKS];
+
+    Hierarchy<L2Cache, L3Cache> lowerLevels;
+    WriteBuffer writeBuffer;
+    Prefetcher prefetcher;
+    PrefetchBuffer prefetchBuffer;
+    std::uint64_t accessCount = 0;
+
+    Timing timing;
+    // latency past the L1 of the line allocateLine last fetched
+    unsigned lastFillLatency = 0;
+    Mmu mmu;
+
+    Stats stats;
+    EventLog<SIM_EVENT_LOG> eventLog;
+
+    // main memory, pages are allocated as they are written
+    PagedMemory memory;
+};
+
+// full 64 bit addresses and the default geometry
+using CacheSimulator = BasicCacheSimulator<>;
+
+#endif
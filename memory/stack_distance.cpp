@@ -0,0 +1,205 @@
+// Single pass multi-size cache simulation.
+// Reads a trace once and prints the LRU hit ratio of every power of two
+// set count and associativity, using stack distance analysis.
+//
+// usage: stack_distance [--line BYTES] [--max-sets N] [--max-ways N] [--verify] <trace>
+//
+// Every lw and sw allocates a line here, so the curves assume write-allocate
+// stores. main.cpp by default sends a store miss to memory without
+// allocating, so its hit count differs whenever a store misses.
+// --verify replays the trace through the Cache template for a few geometries
+// and compares hit counts. It also runs the simulator of main.cpp, its 16
+// entry 2-way cache over 9 bit addresses, once with write-allocate, which
+// must match, and once with its default stores, which is only reported.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include "cache.h"
+#include "simulator.h"
+#include "stack_distance.h"
+#include "trace.h"
+
+using namespace std;
+
+// hits of an exact LRU simulation using the same cache code as main.cpp
+template <size_t Sets, size_t Ways, size_t LineBytes>
+uint64_t simulateLRU(const vector<Access> &accesses)
+{
+    using SimCache = Cache<Sets, Ways, LineBytes, 32>;
+    SimCache cache;
+    uint64_t hits = 0;
+    for (const Access &access : accesses)
+    {
+        uint64_t address = access.address;
+        size_t index = SimCache::getIndex(address);
+        typename SimCache::Tag tag = SimCache::getTag(address);
+        int block = cache.lookup(index, tag);
+        if (block != -1)
+        {
+            hits++;
+            cache.updateHistory(index, block);
+        }
+        else
+        {
+            block = cache.findVictim(index);
+            cache.fill(index, block, tag);
+        }
+    }
+    return hits;
+}
+
+// compare one geometry against the analyzer with the same set count
+template <size_t Sets, size_t Ways, size_t LineBytes>
+bool verify(const vector<Access> &accesses, const vector<StackDistanceAnalyzer> &analyzers, size_t lineBytes, size_t maxWays)
+{
+    if (lineBytes != LineBytes || Ways > maxWays)
+        return true;
+    for (const StackDistanceAnalyzer &analyzer : analyzers)
+    {
+        if (analyzer.sets() != Sets)
+            continue;
+        uint64_t expected = simulateLRU<Sets, Ways, LineBytes>(accesses);
+        uint64_t actual = analyzer.hits(Ways);
+        cout << "verify " << Sets << " sets x " << Ways << " ways: simulated " << expected
+             << " hits, stack distance " << actual << (expected == actual ? "  ok" : "  MISMATCH") << endl;
+        return expected == actual;
+    }
+    return true;
+}
+
+// the simulator main.cpp replays with when built without options
+using ReplaySimulator = BasicCacheSimulator<Cache<8, 2, 4, 9>>;
+
+// hits of the main.cpp simulator with the given store policy, false when an
+// address is past its range
+bool simulateReplay(const vector<Access> &accesses, WriteMiss writeMiss, uint64_t &hits)
+{
+    SimulatorConfig config;
+    config.writeMiss = writeMiss;
+    ReplaySimulator sim(config);
+    for (const Access &access : accesses)
+    {
+        if (!sim.access(access.address, access.isWrite))
+            return false;
+    }
+    hits = sim.statistics().accesses() - sim.statistics().misses();
+    return true;
+}
+
+// compare the main.cpp simulator against the analyzer of its geometry
+bool verifyReplay(const vector<Access> &accesses, const vector<StackDistanceAnalyzer> &analyzers, size_t lineBytes, size_t maxWays)
+{
+    using L1 = ReplaySimulator::L1Cache;
+    if (lineBytes != L1::LINE_BYTES || L1::WAYS > maxWays)
+        return true;
+    for (const StackDistanceAnalyzer &analyzer : analyzers)
+    {
+        if (analyzer.sets() != L1::SETS)
+            continue;
+        uint64_t actual = analyzer.hits(L1::WAYS);
+        uint64_t allocating, defaultHits;
+        cout << "verify main.cpp simulator: ";
+        if (!Stats::ENABLED)
+            cout << "skipped, built without statistics" << endl;
+        else if (!simulateReplay(accesses, WriteMiss::Allocate, allocating) ||
+                 !simulateReplay(accesses, WriteMiss::NoAllocate, defaultHits))
+            cout << "skipped, addresses past its " << L1::ADDR_BITS << " bit range" << endl;
+        else
+        {
+            cout << "write-allocate " << allocating << " hits, stack distance " << actual
+                 << (allocating == actual ? "  ok" : "  MISMATCH") << endl;
+            cout << "verify main.cpp simulator: default stores " << defaultHits
+                 << " hits, not modelled by the curves" << endl;
+            return allocating == actual;
+        }
+        return true;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t lineBytes = 4;
+    size_t maxSets = 16384;
+    size_t maxWays = 16;
+    bool runVerify = false;
+    string fileName;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--line" && i + 1 < argc)
+            lineBytes = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--max-sets" && i + 1 < argc)
+            maxSets = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--max-ways" && i + 1 < argc)
+            maxWays = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--verify")
+            runVerify = true;
+        else
+            fileName = arg;
+    }
+    if (fileName.empty() || !isPowerOfTwo(lineBytes) || lineBytes < 4 || !isPowerOfTwo(maxSets) || maxWays == 0)
+    {
+        cerr << "usage: " << argv[0] << " [--line BYTES] [--max-sets N] [--max-ways N] [--verify] <trace>" << endl;
+        cerr << "The curves assume write-allocate stores, main.cpp does not allocate on a store miss by default." << endl;
+        return 1;
+    }
+
+    vector<uint32_t> instructions;
+    if (!loadInstructions(fileName, instructions))
+    {
+        cerr << "Unable to open file " << fileName << endl;
+        return 1;
+    }
+
+    // one analyzer per set count, all fed in the same pass
+    vector<StackDistanceAnalyzer> analyzers;
+    for (size_t sets = 1; sets <= maxSets; sets *= 2)
+        analyzers.emplace_back(sets, log2Exact(lineBytes), maxWays);
+
+    vector<Access> accesses;
+    for (uint32_t instruction : instructions)
+    {
+        unsigned opcode = getOpcode(instruction);
+        if (opcode != OPCODE_LW && opcode != OPCODE_SW)
+            continue;
+        uint64_t address = getImmediate(instruction);
+        for (StackDistanceAnalyzer &analyzer : analyzers)
+            analyzer.access(address);
+        if (runVerify)
+            accesses.push_back({address, uint8_t(opcode == OPCODE_SW), uint8_t(getRt(instruction))});
+    }
+
+    cout << "Sets\tWays\tBytes\tHits\tMisses\tHit ratio" << endl;
+    for (const StackDistanceAnalyzer &analyzer : analyzers)
+    {
+        for (size_t ways = 1; ways <= maxWays; ways *= 2)
+        {
+            uint64_t hits = analyzer.hits(ways);
+            uint64_t total = analyzer.accesses();
+            cout << analyzer.sets() << "\t" << ways << "\t" << analyzer.sets() * ways * lineBytes << "\t"
+                 << hits << "\t" << total - hits << "\t" << fixed << setprecision(4)
+                 << (total ? double(hits) / total : 0.0) << endl;
+        }
+    }
+
+    if (runVerify)
+    {
+        bool ok = verifyReplay(accesses, analyzers, lineBytes, maxWays);
+        ok = verify<8, 2, 4>(accesses, analyzers, lineBytes, maxWays) && ok;
+        ok = verify<1, 4, 4>(accesses, analyzers, lineBytes, maxWays) && ok;
+        ok = verify<16, 1, 4>(accesses, analyzers, lineBytes, maxWays) && ok;
+        ok = verify<4, 8, 4>(accesses, analyzers, lineBytes, maxWays) && ok;
+        ok = verify<64, 4, 64>(accesses, analyzers, lineBytes, maxWays) && ok;
+        ok = verify<256, 2, 64>(accesses, analyzers, lineBytes, maxWays) && ok;
+        ok = verify<32, 16, 64>(accesses, analyzers, lineBytes, maxWays) && ok;
+        if (!ok)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// LRU stack distance (Mattson) analysis.
+//
+// A single pass over the reference stream computes, for every access, how
+// many distinct lines of the same set were touched since the previous access
+// to the same line. An LRU cache with W ways hits exactly when that distance
+// is below W, so one pass gives the hit ratio of every associativity, and
+// one analyzer per set count covers every capacity.
+
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// distance reported for the first access to a line
+const std::uint64_t COLD_DISTANCE = ~std::uint64_t(0);
+
+// recency stack of one set, kept as a Fenwick tree over access slots.
+// Each live line marks the slot of its latest access, so the number of marks
+// after that slot is its stack distance. Slots are compacted when they run
+// out, which keeps the tree at O(lines) and every access at O(log lines).
+class ReuseStack
+{
+public:
+    // distance of the line, then move it to the top of the stack
+    std::uint64_t access(std::uint64_t line, std::unordered_map<std::uint64_t, std::uint32_t> &slots)
+    {
+        std::uint64_t distance = COLD_DISTANCE;
+        auto found = slots.find(line);
+        if (found != slots.end())
+        {
+            std::uint32_t slot = found->second;
+            distance = live - prefixSum(slot + 1);
+            add(slot, -1);
+            slotLine[slot] = EMPTY;
+        }
+        else
+        {
+            live++;
+        }
+
+        if (next == slotLine.size())
+            compact(slots);
+
+        std::uint32_t slot = std::uint32_t(next++);
+        slotLine[slot] = line;
+        add(slot, 1);
+        slots[line] = slot;
+        return distance;
+    }
+
+private:
+    static constexpr std::uint64_t EMPTY = ~std::uint64_t(0);
+
+    // number of marks in slots [0, end)
+    std::uint64_t prefixSum(std::size_t end) const
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t i = end; i > 0; i -= i & (~i + 1))
+            sum += tree[i - 1];
+        return sum;
+    }
+
+    void add(std::size_t slot, int delta)
+    {
+        for (std::size_t i = slot + 1; i <= tree.size(); i += i & (~i + 1))
+            tree[i - 1] += delta;
+    }
+
+    // renumber live lines into the low slots, keeping their order, and
+    // leave as many free slots as there are live lines
+    void compact(std::unordered_map<std::uint64_t, std::uint32_t> &slots)
+    {
+        std::vector<std::uint64_t> lines;
+        lines.reserve(live);
+        for (std::size_t i = 0; i < next; ++i)
+        {
+            if (slotLine[i] != EMPTY)
+                lines.push_back(slotLine[i]);
+        }
+
+        std::size_t capacity = lines.size() * 2 + 16;
+        slotLine.assign(capacity, EMPTY);
+        tree.assign(capacity, 0);
+        for (std::size_t i = 0; i < lines.size(); ++i)
+        {
+            slotLine[i] = lines[i];
+            slots[lines[i]] = std::uint32_t(i);
+            tree[i] = 1;
+        }
+
+        // linear time Fenwick build
+        for (std::size_t i = 1; i <= capacity; ++i)
+        {
+            std::size_t parent = i + (i & (~i + 1));
+            if (parent <= capacity)
+                tree[parent - 1] += tree[i - 1];
+        }
+        next = lines.size();
+    }
+
+    std::vector<std::uint32_t> tree;
+    std::vector<std::uint64_t> slotLine;
+    std::size_t next = 0;
+    std::size_t live = 0;
+};
+
+// stack distance histogram of one set count
+class StackDistanceAnalyzer
+{
+public:
+    // distances at or beyond maxWays are only counted as misses
+    StackDistanceAnalyzer(std::size_t sets, unsigned offsetBits, std::size_t maxWays)
+        : stacks(sets), histogram(maxWays, 0), offsetBits(offsetBits), setMask(sets - 1)
+    {
+    }
+
+    void access(std::uint64_t address)
+    {
+        std::uint64_t line = address >> offsetBits;
+        std::uint64_t distance = stacks[line & setMask].access(line, slots);
+        references++;
+        if (distance == COLD_DISTANCE)
+            cold++;
+        else if (distance < histogram.size())
+            histogram[distance]++;
+    }
+
+    std::size_t sets() const { return stacks.size(); }
+    std::uint64_t accesses() const { return references; }
+    std::uint64_t coldMisses() const { return cold; }
+
+    // hits of an LRU cache with this set count and the given ways
+    std::uint64_t hits(std::size_t ways) const
+    {
+        std::uint64_t total = 0;
+        for (std::size_t d = 0; d < ways && d < histogram.size(); ++d)
+            total += histogram[d];
+        return total;
+    }
+
+private:
+    std::vector<ReuseStack> stacks;
+    std::unordered_map<std::uint64_t, std::uint32_t> slots;
+    std::vector<std::uint64_t> histogram;
+    unsigned offsetBits;
+    std::uint64_t setMask;
+    std::uint64_t references = 0;
+    std::uint64_t cold = 0;
+};
+
+#endif
@@ -0,0 +1,455 @@
+// Simulation statistics, interval rows and a bounded event log.
+//
+// Counters are on unless the build defines SIM_STATS=0, in which case
+// SimStats is an empty class whose calls compile to nothing. The event log is
+// off unless SIM_EVENT_LOG is defined to the number of events to keep, for
+// example -DSIM_EVENT_LOG=4096.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "miss_class.h"
+
+#ifndef SIM_STATS
+#define SIM_STATS 1
+#endif
+
+#ifndef SIM_EVENT_LOG
+#define SIM_EVENT_LOG 0
+#endif
+
+// cache geometry written with the summary, and whether misses after the
+// first reference are split into capacity and conflict ones, which costs a
+// shadow cache lookup per access. Compulsory misses are always counted.
+struct StatsConfig
+{
+    std::size_t sets;
+    std::size_t ways;
+    std::size_t lineBytes;
+    bool classify = false;
+};
+
+// summary fields contributed by other models, such as the timing layer.
+// Extra types provide writeJSONFields, each line ending in a comma, and
+// writeCSVRows.
+struct NoExtraFields
+{
+    void writeJSONFields(std::ostream &) const {}
+    void writeCSVRows(std::ostream &) const {}
+};
+
+// the fields of two models, one after the other
+template <class First, class Second>
+struct BothFields
+{
+    const First &first;
+    const Second &second;
+
+    void writeJSONFields(std::ostream &out) const
+    {
+        first.writeJSONFields(out);
+        second.writeJSONFields(out);
+    }
+
+    void writeCSVRows(std::ostream &out) const
+    {
+        first.writeCSVRows(out);
+        second.writeCSVRows(out);
+    }
+};
+
+template <class First, class Second>
+BothFields<First, Second> bothFields(const First &first, const Second &second)
+{
+    return {first, second};
+}
+
+template <bool Enabled>
+class SimStats;
+
+template <>
+class SimStats<true>
+{
+public:
+    static const bool ENABLED = true;
+
+    explicit SimStats(StatsConfig config)
+        : config(config), setMisses(config.sets, 0), setConflicts(config.classify ? config.sets : 0, 0),
+          classifier(config.sets * config.ways, config.classify)
+    {
+    }
+
+    // one load or store, line is the address divided by the line size.
+    // Returns the class of a miss, see miss_class.h, Other for a repeat miss
+    // when misses are not classified.
+    MissClass access(bool isWrite, bool hit, std::size_t set, std::uint64_t line)
+    {
+        MissClass missClass = classifier.classify(line, hit);
+        if (isWrite)
+            hit ? storeHits++ : storeMisses++;
+        else
+            hit ? loadHits++ : loadMisses++;
+        if (!hit)
+        {
+            setMisses[set]++;
+            if (missClass == MissClass::Compulsory)
+                coldMisses++;
+            else if (missClass == MissClass::Capacity)
+                capacityMisses++;
+            else if (missClass == MissClass::Conflict)
+            {
+                conflictMisses++;
+                setConflicts[set]++;
+            }
+        }
+        return missClass;
+    }
+
+    void eviction() { evictions++; }
+    void writeback() { writebacks++; }
+
+    // zero the counters at a warmup or region marker. The miss classifier
+    // keeps its history so lines of the warmed cache are not cold again.
+    void resetCounters()
+    {
+        MissClassifier history = std::move(classifier);
+        *this = SimStats(config);
+        classifier = std::move(history);
+    }
+
+    // bytes moved between the cache and the next level
+    void readTraffic(std::uint64_t bytes) { bytesRead += bytes; }
+    void writeTraffic(std::uint64_t bytes) { bytesWritten += bytes; }
+
+    // a prefetch sent to the next level, and the first demand use of a
+    // prefetched line, late when it had not arrived yet
+    void prefetchIssue() { prefetchesIssued++; }
+    void prefetchUse(bool late)
+    {
+        prefetchesUseful++;
+        if (late)
+            prefetchesLate++;
+    }
+
+    // hit on a word the line brought in that had not been used since the fill
+    void spatialHit() { spatialHits++; }
+
+    // words of an evicted line used while it was cached
+    void lineUse(std::size_t wordsUsed) { wordsUsedByEvicted += wordsUsed; }
+
+    std::uint64_t accesses() const { return loadHits + loadMisses + storeHits + storeMisses; }
+    std::uint64_t misses() const { return loadMisses + storeMisses; }
+
+    // prefetches that were used, and misses they removed out of the misses
+    // there would have been without them
+    double prefetchAccuracy() const { return prefetchesIssued ? double(prefetchesUseful) / prefetchesIssued : 0.0; }
+    double prefetchCoverage() const
+    {
+        return prefetchesUseful ? double(prefetchesUseful) / (prefetchesUseful + misses()) : 0.0;
+    }
+
+    // average fraction of an evicted line that was used
+    double lineUtilization() const
+    {
+        return evictions ? double(wordsUsedByEvicted) / (double(evictions) * (config.lineBytes / 4)) : 0.0;
+    }
+
+    template <class Extra = NoExtraFields>
+    void writeJSON(std::ostream &out, const Extra &extra = Extra()) const
+    {
+        out << "{\n";
+        out << "  \"sets\": " << config.sets << ",\n";
+        out << "  \"ways\": " << config.ways << ",\n";
+        out << "  \"line_bytes\": " << config.lineBytes << ",\n";
+        out << "  \"accesses\": " << accesses() << ",\n";
+        out << "  \"load_hits\": " << loadHits << ",\n";
+        out << "  \"load_misses\": " << loadMisses << ",\n";
+        out << "  \"store_hits\": " << storeHits << ",\n";
+        out << "  \"store_misses\": " << storeMisses << ",\n";
+        out << "  \"cold_misses\": " << coldMisses << ",\n";
+        out << "  \"other_misses\": " << misses() - coldMisses << ",\n";
+        if (config.classify)
+        {
+            out << "  \"capacity_misses\": " << capacityMisses << ",\n";
+            out << "  \"conflict_misses\": " << conflictMisses << ",\n";
+        }
+        out << "  \"evictions\": " << evictions << ",\n";
+        out << "  \"writebacks\": " << writebacks << ",\n";
+        out << "  \"bytes_read\": " << bytesRead << ",\n";
+        out << "  \"bytes_written\": " << bytesWritten << ",\n";
+        out << "  \"coalesced_writes\": " << coalescedWrites << ",\n";
+        out << "  \"prefetches_issued\": " << prefetchesIssued << ",\n";
+        out << "  \"prefetches_useful\": " << prefetchesUseful << ",\n";
+        out << "  \"prefetches_late\": " << prefetchesLate << ",\n";
+        out << "  \"prefetch_accuracy\": " << prefetchAccuracy() << ",\n";
+        out << "  \"prefetch_coverage\": " << prefetchCoverage() << ",\n";
+        out << "  \"spatial_hits\": " << spatialHits << ",\n";
+        out << "  \"line_utilization\": " << lineUtilization() << ",\n";
+        out << "  \"miss_ratio\": " << (accesses() ? double(misses()) / accesses() : 0.0) << ",\n";
+        extra.writeJSONFields(out);
+        out << "  \"set_misses\": [";
+        for (std::size_t i = 0; i < setMisses.size(); ++i)
+            out << (i ? ", " : "") << setMisses[i];
+        out << "]";
+        if (config.classify)
+        {
+            out << ",\n  \"set_conflicts\": [";
+            for (std::size_t i = 0; i < setConflicts.size(); ++i)
+                out << (i ? ", " : "") << setConflicts[i];
+            out << "]";
+        }
+        out << "\n}\n";
+    }
+
+    // one counter per row, per set misses as set_misses.N
+    template <class Extra = NoExtraFields>
+    void writeCSV(std::ostream &out, const Extra &extra = Extra()) const
+    {
+        out << "counter,value\n";
+        out << "sets," << config.sets << "\n";
+        out << "ways," << config.ways << "\n";
+        out << "line_bytes," << config.lineBytes << "\n";
+        out << "accesses," << accesses() << "\n";
+        out << "load_hits," << loadHits << "\n";
+        out << "load_misses," << loadMisses << "\n";
+        out << "store_hits," << storeHits << "\n";
+        out << "store_misses," << storeMisses << "\n";
+        out << "cold_misses," << coldMisses << "\n";
+        out << "other_misses," << misses() - coldMisses << "\n";
+        if (config.classify)
+        {
+            out << "capacity_misses," << capacityMisses << "\n";
+            out << "conflict_misses," << conflictMisses << "\n";
+        }
+        out << "evictions," << evictions << "\n";
+        out << "writebacks," << writebacks << "\n";
+        out << "bytes_read," << bytesRead << "\n";
+        out << "bytes_written," << bytesWritten << "\n";
+        out << "coalesced_writes," << coalescedWrites << "\n";
+        out << "prefetches_issued," << prefetchesIssued << "\n";
+        out << "prefetches_useful," << prefetchesUseful << "\n";
+        out << "prefetches_late," << prefetchesLate << "\n";
+        out << "prefetch_accuracy," << prefetchAccuracy() << "\n";
+        out << "prefetch_coverage," << prefetchCoverage() << "\n";
+        out << "spatial_hits," << spatialHits << "\n";
+        out << "line_utilization," << lineUtilization() << "\n";
+        extra.writeCSVRows(out);
+        for (std::size_t i = 0; i < setMisses.size(); ++i)
+            out << "set_misses." << i << "," << setMisses[i] << "\n";
+        for (std::size_t i = 0; i < setConflicts.size(); ++i)
+            out << "set_conflicts." << i << "," << setConflicts[i] << "\n";
+    }
+
+    StatsConfig config;
+    std::uint64_t loadHits = 0;
+    std::uint64_t loadMisses = 0;
+    std::uint64_t storeHits = 0;
+    std::uint64_t storeMisses = 0;
+    std::uint64_t coldMisses = 0; // compulsory
+    std::uint64_t capacityMisses = 0; // these two only when classifying
+    std::uint64_t conflictMisses = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t writebacks = 0;
+    std::uint64_t bytesRead = 0;
+    std::uint64_t bytesWritten = 0;
+    std::uint64_t coalescedWrites = 0; // set from the write buffer
+    std::uint64_t prefetchesIssued = 0;
+    std::uint64_t prefetchesUseful = 0;
+    std::uint64_t prefetchesLate = 0;
+    std::uint64_t spatialHits = 0;
+    std::uint64_t wordsUsedByEvicted = 0;
+    std::vector<std::uint64_t> setMisses;
+    std::vector<std::uint64_t> setConflicts;
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(config, loadHits, loadMisses, storeHits, storeMisses, coldMisses, capacityMisses, conflictMisses, evictions,
+                writebacks, bytesRead, bytesWritten, coalescedWrites, prefetchesIssued, prefetchesUseful, prefetchesLate,
+                spatialHits, wordsUsedByEvicted, setMisses, setConflicts, classifier);
+    }
+
+private:
+    MissClassifier classifier;
+};
+
+// compiled out, every call is empty
+template <>
+class SimStats<false>
+{
+public:
+    static const bool ENABLED = false;
+
+    explicit SimStats(StatsConfig) {}
+
+    // misses are not classified
+    MissClass access(bool, bool, std::size_t, std::uint64_t) { return MissClass::Hit; }
+    void eviction() {}
+    void writeback() {}
+    void resetCounters() {}
+    void readTraffic(std::uint64_t) {}
+    void writeTraffic(std::uint64_t) {}
+    void prefetchIssue() {}
+    void prefetchUse(bool) {}
+    void spatialHit() {}
+    void lineUse(std::size_t) {}
+
+    std::uint64_t accesses() const { return 0; }
+    std::uint64_t misses() const { return 0; }
+
+    template <class Extra = NoExtraFields>
+    void writeJSON(std::ostream &out, const Extra &extra = Extra()) const
+    {
+        out << "{\n";
+        extra.writeJSONFields(out);
+        out << "  \"stats\": \"disabled\"\n";
+        out << "}\n";
+    }
+
+    template <class Extra = NoExtraFields>
+    void writeCSV(std::ostream &out, const Extra &extra = Extra()) const
+    {
+        out << "counter,value\n";
+        extra.writeCSVRows(out);
+    }
+
+    std::uint64_t loadHits = 0;
+    std::uint64_t loadMisses = 0;
+    std::uint64_t storeHits = 0;
+    std::uint64_t storeMisses = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t writebacks = 0;
+    std::uint64_t coalescedWrites = 0;
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(loadHits, loadMisses, storeHits, storeMisses, evictions, writebacks, coalescedWrites);
+    }
+};
+
+using Stats = SimStats<SIM_STATS != 0>;
+
+// statistics of every interval as CSV rows, from the differences of the
+// running counters between rows. References are trace instructions, so
+// MPKI is misses per thousand of them.
+class IntervalLog
+{
+public:
+    explicit IntervalLog(std::ostream &out) : out(out) {}
+
+    void writeHeader()
+    {
+        out << "interval,references,accesses,hit_rate,mpki,writebacks,evictions,marker\n";
+    }
+
+    // the row of the references since the last one, ending with marker
+    void row(const Stats &stats, std::uint64_t references, const char *marker = "")
+    {
+        std::uint64_t accesses = stats.loadHits + stats.loadMisses + stats.storeHits + stats.storeMisses - last.accesses;
+        std::uint64_t misses = stats.loadMisses + stats.storeMisses - last.misses;
+        std::uint64_t span = references - lastReferences;
+        out << intervals++ << "," << references << "," << accesses << ","
+            << (accesses ? double(accesses - misses) / accesses : 0.0) << ","
+            << (span ? misses * 1000.0 / span : 0.0) << "," << stats.writebacks - last.writebacks << ","
+            << stats.evictions - last.evictions << "," << marker << "\n";
+        rebase(stats, references);
+    }
+
+    // count the next row from these counters, after a reset or restore
+    void rebase(const Stats &stats, std::uint64_t references)
+    {
+        last.accesses = stats.loadHits + stats.loadMisses + stats.storeHits + stats.storeMisses;
+        last.misses = stats.loadMisses + stats.storeMisses;
+        last.writebacks = stats.writebacks;
+        last.evictions = stats.evictions;
+        lastReferences = references;
+    }
+
+    std::uint64_t lastRow() const { return lastReferences; }
+
+private:
+    struct Counters
+    {
+        std::uint64_t accesses = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t writebacks = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    std::ostream &out;
+    Counters last;
+    std::uint64_t lastReferences = 0;
+    std::uint64_t intervals = 0;
+};
+
+enum class EventType : std::uint8_t
+{
+    LoadHit,
+    LoadMiss,
+    StoreHit,
+    StoreMiss,
+    Eviction,
+    Writeback
+};
+
+inline const char *eventName(EventType type)
+{
+    static const char *names[] = {"lw hit", "lw miss", "sw hit", "sw miss", "evict", "writeback"};
+    return names[int(type)];
+}
+
+// the last Capacity events, overwritten oldest first
+template <std::size_t Capacity>
+class EventLog
+{
+public:
+    static const bool ENABLED = Capacity != 0;
+
+    void record(EventType type, std::uint64_t address)
+    {
+        if (!ENABLED)
+            return;
+        Event &event = events[next % (Capacity ? Capacity : 1)];
+        event.sequence = next++;
+        event.address = address;
+        event.type = type;
+    }
+
+    void dump(std::ostream &out) const
+    {
+        std::uint64_t first = next > Capacity ? next - Capacity : 0;
+        for (std::uint64_t i = first; i < next; ++i)
+        {
+            const Event &event = events[i % (Capacity ? Capacity : 1)];
+            out << event.sequence << "\t" << eventName(event.type) << "\t" << event.address << "\n";
+        }
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(events, next);
+    }
+
+private:
+    struct Event
+    {
+        std::uint64_t sequence;
+        std::uint64_t address;
+        EventType type;
+    };
+
+    Event events[Capacity ? Capacity : 1];
+    std::uint64_t next = 0;
+};
+
+#endif
@@ -0,0 +1,305 @@
+// Parallel cache configuration sweep.
+// The trace is decoded once into an immutable buffer shared by every task,
+// then each configuration runs as an independent task on a work stealing
+// thread pool and the per-configuration statistics are printed together.
+//
+// usage: sweep [--threads N] [--policy NAME] [--line BYTES] [--ways N]
+//              [--min-bytes N] [--max-bytes N] [--sample-sets N[,PHASE]]
+//              [--sample-time PERIOD,DETAIL[,WARMUP]] <trace>
+//
+// Loads allocate on a miss and stores do not, as in main.cpp.
+//
+// --sample-sets and --sample-time simulate part of the trace, see
+// sampling.h, and add the 95% confidence interval of each miss ratio.
+// Caches with no more sets than the set period are simulated in full, and
+// a time sampled run with fewer than two windows prints n/a for its
+// interval.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+#include "cache.h"
+#include "sampling.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+using namespace std;
+
+// sweep statistics of one configuration
+struct SweepResult
+{
+    uint64_t loads = 0;
+    uint64_t stores = 0;
+    uint64_t loadHits = 0;
+    uint64_t storeHits = 0;
+    uint64_t evictions = 0;
+    double seconds = 0;
+    vector<SampleUnit> units; // per set, or per window when sampled in time
+};
+
+struct SweepConfig
+{
+    const char *policy;
+    size_t sets;
+    size_t ways;
+    size_t lineBytes;
+    SweepResult (*run)(const SampledTrace &trace);
+};
+
+const unsigned SWEEP_ADDR_BITS = 32;
+
+// simulate one geometry over the shared trace, counting the measured part
+// of each window
+template <template <size_t, size_t> class Policy, size_t Sets, size_t Ways, size_t LineBytes>
+SweepResult runConfig(const SampledTrace &trace)
+{
+    using SweepCache = Cache<Sets, Ways, LineBytes, SWEEP_ADDR_BITS, Policy>;
+    SweepCache cache;
+    SweepResult result;
+    result.units.resize(trace.timeSampled ? trace.windows.size() : Sets);
+
+    for (size_t w = 0; w < trace.windows.size(); ++w)
+    {
+        const TraceWindow &window = trace.windows[w];
+        for (size_t i = window.begin; i < window.end; ++i)
+        {
+            const Access &access = trace.accesses[i];
+            size_t index = SweepCache::getIndex(access.address);
+            typename SweepCache::Tag tag = SweepCache::getTag(access.address);
+            int block = cache.lookup(index, tag);
+            bool hit = block != -1;
+            bool evicted = false;
+
+            if (hit)
+            {
+                cache.updateHistory(index, block);
+                if (access.isWrite)
+                    cache.setDirty(index, block);
+            }
+            else if (!access.isWrite)
+            {
+                block = cache.findVictim(index);
+                evicted = cache.isValid(index, block);
+                cache.fill(index, block, tag);
+            }
+
+            // warming references only update the cache
+            if (i < window.measureFrom)
+                continue;
+            if (access.isWrite)
+            {
+                result.stores++;
+                result.storeHits += hit;
+            }
+            else
+            {
+                result.loads++;
+                result.loadHits += hit;
+            }
+            result.evictions += evicted;
+            SampleUnit &unit = result.units[trace.timeSampled ? w : index];
+            unit.accesses++;
+            unit.misses += !hit;
+        }
+    }
+    return result;
+}
+
+// every set count from 2^FirstBit up to 2^14 for one associativity and line size
+template <template <size_t, size_t> class Policy, size_t LineBytes, size_t Ways, size_t FirstBit, size_t... SetBits>
+void addSetCounts(vector<SweepConfig> &configs, index_sequence<SetBits...>)
+{
+    int expand[] = {(configs.push_back({Policy<1, Ways>::name(), size_t(1) << (FirstBit + SetBits), Ways, LineBytes,
+                                        &runConfig<Policy, (size_t(1) << (FirstBit + SetBits)), Ways, LineBytes>}),
+                     0)...};
+    (void)expand;
+}
+
+template <template <size_t, size_t> class Policy, size_t LineBytes, size_t FirstBit, size_t... Ways>
+void addLineSize(vector<SweepConfig> &configs)
+{
+    int expand[] = {(addSetCounts<Policy, LineBytes, Ways, FirstBit>(configs, make_index_sequence<15 - FirstBit>()), 0)...};
+    (void)expand;
+}
+
+// LRU over 1 to 16 ways, 32 to 128 byte lines and up to 16384 sets, then
+// every other policy over the wider 64 byte line caches of 64 sets or more
+vector<SweepConfig> allConfigs()
+{
+    vector<SweepConfig> configs;
+    addLineSize<LRUPolicy, 32, 0, 1, 2, 4, 8, 16>(configs);
+    addLineSize<LRUPolicy, 64, 0, 1, 2, 4, 8, 16>(configs);
+    addLineSize<LRUPolicy, 128, 0, 1, 2, 4, 8, 16>(configs);
+    addLineSize<TreePLRUPolicy, 64, 6, 4, 8, 16>(configs);
+    addLineSize<SRRIPPolicy, 64, 6, 4, 8, 16>(configs);
+    addLineSize<BRRIPPolicy, 64, 6, 4, 8, 16>(configs);
+    addLineSize<FIFOPolicy, 64, 6, 4, 8, 16>(configs);
+    addLineSize<RandomPolicy, 64, 6, 4, 8, 16>(configs);
+    return configs;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t threads = thread::hardware_concurrency();
+    string policy;
+    size_t lineBytes = 0;
+    size_t ways = 0;
+    size_t minBytes = 0;
+    size_t maxBytes = SIZE_MAX;
+    SamplingConfig sampling;
+    string fileName;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            threads = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--policy" && i + 1 < argc)
+            policy = argv[++i];
+        else if (arg == "--line" && i + 1 < argc)
+            lineBytes = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--ways" && i + 1 < argc)
+            ways = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--min-bytes" && i + 1 < argc)
+            minBytes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--max-bytes" && i + 1 < argc)
+            maxBytes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--sample-sets" && i + 1 < argc)
+        {
+            // period[,phase]
+            char *end = nullptr;
+            sampling.setPeriod = strtoul(argv[++i], &end, 10);
+            if (*end == ',')
+                sampling.setPhase = strtoul(end + 1, nullptr, 10);
+        }
+        else if (arg == "--sample-time" && i + 1 < argc)
+        {
+            // period,detail[,warmup]
+            char *end = nullptr;
+            sampling.timePeriod = strtoull(argv[++i], &end, 10);
+            if (*end == ',')
+                sampling.detail = strtoull(end + 1, &end, 10);
+            if (*end == ',')
+                sampling.warmup = strtoull(end + 1, nullptr, 10);
+        }
+        else
+            fileName = arg;
+    }
+    if (fileName.empty())
+    {
+        cerr << "usage: " << argv[0] << " [--threads N] [--policy NAME] [--line BYTES] [--ways N] [--min-bytes N] [--max-bytes N]"
+             << " [--sample-sets N[,PHASE]] [--sample-time PERIOD,DETAIL[,WARMUP]] <trace>" << endl;
+        return 1;
+    }
+    if (sampling.setPeriod == 0 || (sampling.setPeriod & (sampling.setPeriod - 1)) || sampling.setPhase >= sampling.setPeriod ||
+        (sampling.timeSampled() && (sampling.detail == 0 || sampling.detail + sampling.warmup > sampling.timePeriod)))
+    {
+        cerr << "the set period must be a power of two above the phase, and the detail and warmup must fit the time period" << endl;
+        return 1;
+    }
+
+    // decode once, every task reads the same buffer
+    vector<uint32_t> instructions;
+    if (!loadInstructions(fileName, instructions))
+    {
+        cerr << "Unable to open file " << fileName << endl;
+        return 1;
+    }
+    vector<Access> trace = decodeAccesses(instructions);
+    instructions.clear();
+    instructions.shrink_to_fit();
+
+    // the windows of every cache, then for each line size the references
+    // of the sampled sets, filtered before any cache runs
+    const SampledTrace all = sampleTrace(trace, sampling, 0);
+    SampledTrace sets[3];
+    const size_t lineSizes[3] = {32, 64, 128};
+    for (int s = 0; s < 3 && sampling.setSampled(); ++s)
+        sets[s] = sampleTrace(trace, sampling, lineSizes[s]);
+    size_t traceSize = trace.size();
+    trace.clear();
+    trace.shrink_to_fit();
+
+    vector<SweepConfig> configs;
+    for (const SweepConfig &config : allConfigs())
+    {
+        size_t bytes = config.sets * config.ways * config.lineBytes;
+        if ((policy.empty() || policy == config.policy) && (lineBytes == 0 || config.lineBytes == lineBytes) &&
+            (ways == 0 || config.ways == ways) && bytes >= minBytes && bytes <= maxBytes)
+            configs.push_back(config);
+    }
+
+    vector<SweepResult> results(configs.size());
+    auto start = chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < configs.size(); ++i)
+        {
+            pool.submit([&, i]
+                        {
+                            auto taskStart = chrono::steady_clock::now();
+                            const SweepConfig &config = configs[i];
+                            const SampledTrace *input = &all;
+                            for (int s = 0; s < 3; ++s)
+                            {
+                                if (sampling.setSampled() && config.lineBytes == lineSizes[s] && config.sets > sampling.setPeriod)
+                                    input = &sets[s];
+                            }
+                            results[i] = config.run(*input);
+                            results[i].seconds = chrono::duration<double>(chrono::steady_clock::now() - taskStart).count();
+                        });
+        }
+        pool.wait();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool sampled = sampling.setSampled() || sampling.timeSampled();
+    cout << "Policy\tSets\tWays\tLine\tBytes\tLoads\tStores\tLd hits\tSt hits\tMiss ratio\t" << (sampled ? "+-95%\t" : "")
+         << "Evictions\tSeconds" << endl;
+    for (size_t i = 0; i < configs.size(); ++i)
+    {
+        const SweepConfig &config = configs[i];
+        const SweepResult &result = results[i];
+        uint64_t accesses = result.loads + result.stores;
+        uint64_t misses = accesses - result.loadHits - result.storeHits;
+        cout << config.policy << "\t" << config.sets << "\t" << config.ways << "\t" << config.lineBytes << "\t"
+             << config.sets * config.ways * config.lineBytes << "\t" << result.loads << "\t" << result.stores << "\t"
+             << result.loadHits << "\t" << result.storeHits << "\t" << fixed << setprecision(4)
+             << (accesses ? double(misses) / accesses : 0.0) << "\t";
+        if (sampled)
+        {
+            // full runs of caches up to the set period are exact, and one
+            // unit gives no interval
+            vector<SampleUnit> units;
+            bool bySet = !sampling.timeSampled();
+            for (size_t unit = 0; unit < result.units.size(); ++unit)
+            {
+                if (!bySet || unit % sampling.setPeriod == sampling.setPhase)
+                    units.push_back(result.units[unit]);
+            }
+            bool exact = bySet && config.sets <= sampling.setPeriod;
+            if (exact)
+                cout << 0.0 << "\t";
+            else if (units.size() < 2)
+                cout << "n/a\t";
+            else
+                cout << estimateRatio(units, sampling.fraction()).halfWidth << "\t";
+        }
+        cout << result.evictions << "\t"
+             << setprecision(3) << result.seconds << endl;
+    }
+    if (sampled)
+    {
+        cerr << "sampled " << (sampling.setSampled() ? sets[1].accesses.size() : all.accesses.size()) << " of " << traceSize
+             << " accesses for 64 byte lines" << endl;
+    }
+    cerr << configs.size() << " configurations, " << traceSize << " accesses, " << threads << " threads, "
+         << fixed << setprecision(3) << elapsed << " s" << endl;
+    return 0;
+}
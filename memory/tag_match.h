@@ -0,0 +1,119 @@
+// Way-parallel tag comparison.
+//
+// matchTags compares a probe tag against every way of a tag row and returns
+// one bit per matching way. Rows of 32 bytes or more are compared 32 bytes
+// at a time when the build targets AVX2, rows of 16 bytes or more 16 bytes
+// at a time with SSE2, each chunk with one compare and one movemask. Smaller
+// rows and other hosts use the scalar loop.
+//
+// The vector paths may read up to the end of the padded row, so rows must be
+// aligned and padded to the power of two at or above their size, up to 64
+// bytes, as Cache::TagRow is. Bits past the last way are garbage and must be
+// masked off by the caller, which the valid mask already does.
+
+#ifndef TAG_MATCH_H
+#define TAG_MATCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+template <class Tag, std::size_t Ways>
+inline std::uint64_t matchTagsScalar(const Tag *row, Tag tag)
+{
+    std::uint64_t match = 0;
+    for (std::size_t i = 0; i < Ways; ++i)
+        match |= std::uint64_t(row[i] == tag) << i;
+    return match;
+}
+
+#ifdef __SSE2__
+// one bit per tag of a 16 byte chunk
+inline std::uint64_t matchChunk128(const std::uint8_t *chunk, std::uint8_t tag)
+{
+    __m128i eq = _mm_cmpeq_epi8(_mm_load_si128((const __m128i *)chunk), _mm_set1_epi8(char(tag)));
+    return std::uint32_t(_mm_movemask_epi8(eq));
+}
+
+inline std::uint64_t matchChunk128(const std::uint16_t *chunk, std::uint16_t tag)
+{
+    __m128i eq = _mm_cmpeq_epi16(_mm_load_si128((const __m128i *)chunk), _mm_set1_epi16(short(tag)));
+    return std::uint32_t(_mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128())));
+}
+
+inline std::uint64_t matchChunk128(const std::uint32_t *chunk, std::uint32_t tag)
+{
+    __m128i eq = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)chunk), _mm_set1_epi32(int(tag)));
+    return std::uint32_t(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+}
+
+inline std::uint64_t matchChunk128(const std::uint64_t *chunk, std::uint64_t tag)
+{
+    // both 32 bit halves must match
+    __m128i eq = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)chunk), _mm_set1_epi64x((long long)tag));
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, 0xB1));
+    return std::uint32_t(_mm_movemask_pd(_mm_castsi128_pd(eq)));
+}
+#endif
+
+#ifdef __AVX2__
+// one bit per tag of a 32 byte chunk
+inline std::uint64_t matchChunk256(const std::uint8_t *chunk, std::uint8_t tag)
+{
+    __m256i eq = _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)chunk), _mm256_set1_epi8(char(tag)));
+    return std::uint32_t(_mm256_movemask_epi8(eq));
+}
+
+inline std::uint64_t matchChunk256(const std::uint16_t *chunk, std::uint16_t tag)
+{
+    // the pack works per 128 bit lane, leaving the two halves at bits 0 and 16
+    __m256i eq = _mm256_cmpeq_epi16(_mm256_load_si256((const __m256i *)chunk), _mm256_set1_epi16(short(tag)));
+    std::uint32_t bits = std::uint32_t(_mm256_movemask_epi8(_mm256_packs_epi16(eq, _mm256_setzero_si256())));
+    return (bits & 0xFF) | ((bits >> 8) & 0xFF00);
+}
+
+inline std::uint64_t matchChunk256(const std::uint32_t *chunk, std::uint32_t tag)
+{
+    __m256i eq = _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i *)chunk), _mm256_set1_epi32(int(tag)));
+    return std::uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+}
+
+inline std::uint64_t matchChunk256(const std::uint64_t *chunk, std::uint64_t tag)
+{
+    __m256i eq = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *)chunk), _mm256_set1_epi64x((long long)tag));
+    return std::uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+}
+#endif
+
+// bit i is set when way i of the row holds the tag
+template <class Tag, std::size_t Ways>
+inline std::uint64_t matchTags(const Tag *row, Tag tag)
+{
+    constexpr std::size_t ROW_BYTES = Ways * sizeof(Tag);
+#ifdef __AVX2__
+    if (ROW_BYTES >= 32)
+    {
+        constexpr std::size_t PER_CHUNK = 32 / sizeof(Tag);
+        std::uint64_t match = 0;
+        for (std::size_t first = 0; first < Ways; first += PER_CHUNK)
+            match |= matchChunk256(row + first, tag) << first;
+        return match;
+    }
+#endif
+#ifdef __SSE2__
+    if (ROW_BYTES >= 16)
+    {
+        constexpr std::size_t PER_CHUNK = 16 / sizeof(Tag);
+        std::uint64_t match = 0;
+        for (std::size_t first = 0; first < Ways; first += PER_CHUNK)
+            match |= matchChunk128(row + first, tag) << first;
+        return match;
+    }
+#endif
+    return matchTagsScalar<Tag, Ways>(row, tag);
+}
+
+#endif
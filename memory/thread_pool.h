@@ -0,0 +1,146 @@
+// Work stealing thread pool for coarse grained tasks.
+// Every worker owns a deque: it pops its own newest task and, when that is
+// empty, steals the oldest task of another worker.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t threads)
+    {
+        if (threads == 0)
+            threads = 1;
+        for (std::size_t i = 0; i < threads; ++i)
+            queues.emplace_back(new WorkQueue);
+        for (std::size_t i = 0; i < threads; ++i)
+            workers.emplace_back(&ThreadPool::run, this, i);
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    std::size_t size() const { return workers.size(); }
+
+    // queue a task, spreading tasks round robin over the workers
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            pending++;
+        }
+        WorkQueue &queue = *queues[nextQueue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            queued++;
+        }
+        wake.notify_one();
+    }
+
+    // block until every submitted task has finished
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool popLocal(std::size_t self, std::function<void()> &task)
+    {
+        WorkQueue &queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t self, std::function<void()> &task)
+    {
+        for (std::size_t i = 1; i < queues.size(); ++i)
+        {
+            WorkQueue &queue = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::size_t self)
+    {
+        std::function<void()> task;
+        while (true)
+        {
+            if (popLocal(self, task) || steal(self, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(stateMutex);
+                    queued--;
+                }
+                task();
+                task = nullptr;
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (--pending == 0)
+                    done.notify_all();
+                continue;
+            }
+
+            // nothing to run, sleep until a task is queued or the pool stops
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued <= 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> nextQueue{0};
+
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::size_t pending = 0;
+    long queued = 0; // tasks sitting in the queues
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,249 @@
+// Cycle-approximate timing for a non-blocking cache.
+//
+// Accesses issue in order, one per cycle, and never wait for each other's
+// data. A hit completes after the hit latency. A miss that needs a fill
+// takes a miss status holding register until the line arrives; a later
+// access to a line that is still outstanding merges into its MSHR and waits
+// for the same fill, and a new miss with every MSHR busy stalls issue until
+// the oldest fill completes. The functional cache is updated at once, so
+// merging is what keeps hits on in-flight lines from looking free.
+//
+// The layer is on unless the build defines SIM_TIMING=0, in which case
+// TimingModel is empty and costs nothing.
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#ifndef SIM_TIMING
+#define SIM_TIMING 1
+#endif
+
+struct TimingConfig
+{
+    unsigned hitLatency = 1;
+    std::size_t mshrs = 8;
+};
+
+template <bool Enabled>
+class TimingModel;
+
+template <>
+class TimingModel<true>
+{
+public:
+    static const bool ENABLED = true;
+
+    explicit TimingModel(TimingConfig config = TimingConfig()) { configure(config); }
+
+    void configure(TimingConfig timingConfig)
+    {
+        config = timingConfig;
+        if (config.mshrs == 0)
+            config.mshrs = 1;
+        mshr.clear();
+    }
+
+    // one access to the line. fill is true for a miss that brings the line
+    // in, missLatency is its latency past the hit latency.
+    void access(std::uint64_t line, bool hit, bool fill, unsigned missLatency)
+    {
+        retire();
+        std::uint64_t done = now + config.hitLatency;
+
+        Entry *pending = find(line);
+        if (pending)
+        {
+            // the line is still on its way
+            merged++;
+            if (pending->ready > done)
+                done = pending->ready;
+        }
+        else if (!hit && fill)
+        {
+            if (mshr.size() == config.mshrs)
+            {
+                // wait for the first fill to free its register
+                std::uint64_t first = mshr[0].ready;
+                for (const Entry &entry : mshr)
+                    first = entry.ready < first ? entry.ready : first;
+                stallCycles += first - now;
+                now = first;
+                retire();
+                done = now + config.hitLatency;
+            }
+            done += missLatency;
+            mshr.push_back({line, done});
+            fills++;
+            missCycles += done - now;
+            busy(now, done);
+        }
+
+        accesses++;
+        latencyCycles += done - now;
+        if (done > finish)
+            finish = done;
+        now++;
+    }
+
+    // a page walk that blocks issue for the given cycles
+    void walk(unsigned walkCycles)
+    {
+        now += walkCycles;
+        walkStallCycles += walkCycles;
+    }
+
+    // a prefetch of the line issued now, which later accesses merge into.
+    // Prefetches never stall issue and are dropped when every MSHR is busy.
+    void prefetch(std::uint64_t line, unsigned missLatency)
+    {
+        retire();
+        if (find(line) || mshr.size() == config.mshrs)
+            return;
+        std::uint64_t ready = now + config.hitLatency + missLatency;
+        mshr.push_back({line, ready});
+        if (ready > finish)
+            finish = ready;
+    }
+
+    std::uint64_t cycles() const { return (finish > now ? finish : now) - cycleBase; }
+
+    // zero the counters, cycles count from here on
+    void resetCounters()
+    {
+        cycleBase += cycles();
+        accesses = fills = merged = stallCycles = walkStallCycles = 0;
+        latencyCycles = missCycles = busyCycles = 0;
+    }
+
+    // average memory access time in cycles
+    double amat() const { return accesses ? double(latencyCycles) / accesses : 0.0; }
+
+    // average fills in flight while at least one is
+    double mlp() const { return busyCycles ? double(missCycles) / busyCycles : 0.0; }
+
+    // fields for the JSON summary, each line ending in a comma
+    void writeJSONFields(std::ostream &out) const
+    {
+        out << "  \"cycles\": " << cycles() << ",\n";
+        out << "  \"amat\": " << amat() << ",\n";
+        out << "  \"mlp\": " << mlp() << ",\n";
+        out << "  \"mshr_fills\": " << fills << ",\n";
+        out << "  \"mshr_merges\": " << merged << ",\n";
+        out << "  \"mshr_stall_cycles\": " << stallCycles << ",\n";
+    }
+
+    void writeCSVRows(std::ostream &out) const
+    {
+        out << "cycles," << cycles() << "\n";
+        out << "amat," << amat() << "\n";
+        out << "mlp," << mlp() << "\n";
+        out << "mshr_fills," << fills << "\n";
+        out << "mshr_merges," << merged << "\n";
+        out << "mshr_stall_cycles," << stallCycles << "\n";
+    }
+
+    std::uint64_t accesses = 0;
+    std::uint64_t fills = 0;          // misses that took an MSHR
+    std::uint64_t merged = 0;         // accesses merged into an outstanding MSHR
+    std::uint64_t stallCycles = 0;    // issue stalled on full MSHRs
+    std::uint64_t walkStallCycles = 0; // issue stalled on page walks
+    std::uint64_t latencyCycles = 0;  // sum of access latencies
+    std::uint64_t missCycles = 0;     // sum of fill latencies
+    std::uint64_t busyCycles = 0;     // cycles with at least one fill in flight
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(config, mshr, now, finish, busyUntil, cycleBase, accesses, fills, merged, stallCycles, walkStallCycles,
+                latencyCycles, missCycles, busyCycles);
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t line;
+        std::uint64_t ready;
+    };
+
+    // free the registers whose fill has arrived
+    void retire()
+    {
+        std::size_t kept = 0;
+        for (const Entry &entry : mshr)
+        {
+            if (entry.ready > now)
+                mshr[kept++] = entry;
+        }
+        mshr.resize(kept);
+    }
+
+    Entry *find(std::uint64_t line)
+    {
+        for (Entry &entry : mshr)
+        {
+            if (entry.line == line)
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    // add [start, end) to the union of fill intervals; starts never go back
+    void busy(std::uint64_t start, std::uint64_t end)
+    {
+        if (start < busyUntil)
+            start = busyUntil;
+        if (end > start)
+            busyCycles += end - start;
+        if (end > busyUntil)
+            busyUntil = end;
+    }
+
+    TimingConfig config;
+    std::vector<Entry> mshr;
+    std::uint64_t now = 0;
+    std::uint64_t finish = 0;
+    std::uint64_t busyUntil = 0;
+    std::uint64_t cycleBase = 0; // cycles() at the last reset
+};
+
+// compiled out, every call is empty
+template <>
+class TimingModel<false>
+{
+public:
+    static const bool ENABLED = false;
+
+    explicit TimingModel(TimingConfig = TimingConfig()) {}
+
+    void configure(TimingConfig) {}
+    void access(std::uint64_t, bool, bool, unsigned) {}
+    void walk(unsigned) {}
+    void prefetch(std::uint64_t, unsigned) {}
+    void resetCounters() {}
+
+    std::uint64_t cycles() const { return 0; }
+    double amat() const { return 0.0; }
+    double mlp() const { return 0.0; }
+
+    void writeJSONFields(std::ostream &) const {}
+    void writeCSVRows(std::ostream &) const {}
+
+    std::uint64_t fills = 0;
+    std::uint64_t merged = 0;
+    std::uint64_t stallCycles = 0;
+
+    template <class Archive>
+    void transfer(Archive &)
+    {
+    }
+};
+
+using Timing = TimingModel<SIM_TIMING != 0>;
+
+#endif
@@ -0,0 +1,292 @@
+// Address translation: TLBs and a page table walker.
+//
+// A virtual address is looked up in a small L1 dTLB, then in a larger L2
+// TLB, and when both miss the page table is walked. The page table is a
+// four level radix tree as on x86-64, 9 index bits per level above the page
+// offset: a 4 KB page needs all four levels, a 2 MB page stops at the page
+// directory and a 1 GB page at the page directory pointer table. Huge pages
+// therefore shorten every walk as well as widening TLB reach.
+//
+// Table pages are allocated on first touch from a physical pool starting at
+// tableBase, which by default is TABLES_AT_TOP: the owner of the address
+// space places the pool above every address its data can use. Data pages are mapped virtual equals physical, so the values a
+// program reads do not depend on the mapping and only the cost changes.
+// Each entry read by a walk is handed to the caller, which sends it through
+// its caches and returns the cycles it took.
+
+#ifndef TLB_H
+#define TLB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+enum class PageSize
+{
+    Small, // 4 KB
+    Large, // 2 MB
+    Huge   // 1 GB
+};
+
+inline const char *pageSizeName(PageSize size)
+{
+    static const char *names[] = {"4k", "2m", "1g"};
+    return names[int(size)];
+}
+
+inline unsigned pageShift(PageSize size)
+{
+    static const unsigned shifts[] = {12, 21, 30};
+    return shifts[int(size)];
+}
+
+struct TlbConfig
+{
+    std::size_t entries;
+    std::size_t ways;
+    unsigned latency; // cycles added by a hit at this level
+};
+
+// set associative TLB of virtual page numbers with LRU replacement
+class Tlb
+{
+public:
+    void configure(TlbConfig tlbConfig)
+    {
+        config = tlbConfig;
+        if (config.ways == 0)
+            config.ways = 1;
+        if (config.entries < config.ways)
+            config.entries = config.ways;
+        sets = config.entries / config.ways;
+        entries.assign(sets * config.ways, Entry());
+        clock = 0;
+    }
+
+    const TlbConfig &getConfig() const { return config; }
+
+    bool lookup(std::uint64_t page)
+    {
+        Entry *set = &entries[(page % sets) * config.ways];
+        for (std::size_t way = 0; way < config.ways; ++way)
+        {
+            if (set[way].valid && set[way].page == page)
+            {
+                set[way].used = ++clock;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(std::uint64_t page)
+    {
+        Entry *set = &entries[(page % sets) * config.ways];
+        Entry *victim = &set[0];
+        for (std::size_t way = 0; way < config.ways; ++way)
+        {
+            if (!set[way].valid)
+            {
+                victim = &set[way];
+                break;
+            }
+            if (set[way].used < victim->used)
+                victim = &set[way];
+        }
+        *victim = {page, ++clock, true};
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(config, sets, entries, clock);
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t page = 0;
+        std::uint64_t used = 0;
+        bool valid = false;
+    };
+
+    TlbConfig config = {0, 1, 0};
+    std::size_t sets = 1;
+    std::vector<Entry> entries;
+    std::uint64_t clock = 0;
+};
+
+// four level radix page table, tables allocated on first touch
+class PageTable
+{
+public:
+    static const unsigned LEVELS = 4;
+    static const unsigned INDEX_BITS = 9;
+    static const std::uint64_t TABLE_BYTES = 4096;
+    static const std::uint64_t ENTRY_BYTES = 8;
+
+    void configure(std::uint64_t base)
+    {
+        tableBase = base;
+        tables.clear();
+    }
+
+    std::size_t tablePages() const { return tables.size(); }
+
+    // physical address of the entry for the address in the table of the
+    // level, from LEVELS at the root down to 1
+    std::uint64_t entryAddress(std::uint64_t address, unsigned level)
+    {
+        unsigned shift = 12 + INDEX_BITS * (level - 1);
+        // the table is named by its level and the address bits above it
+        std::uint64_t key = (address >> (shift + INDEX_BITS) << 3) | level;
+        auto table = tables.find(key);
+        if (table == tables.end())
+            table = tables.emplace(key, tableBase + tables.size() * TABLE_BYTES).first;
+        std::uint64_t index = (address >> shift) & ((std::uint64_t(1) << INDEX_BITS) - 1);
+        return table->second + index * ENTRY_BYTES;
+    }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(tableBase, tables);
+    }
+
+private:
+    std::uint64_t tableBase = 0;
+    std::unordered_map<std::uint64_t, std::uint64_t> tables;
+};
+
+struct MmuConfig
+{
+    PageSize pageSize = PageSize::Small;
+    TlbConfig l1 = {64, 4, 0};
+    TlbConfig l2 = {1536, 12, 7};
+    std::uint64_t tableBase = TABLES_AT_TOP;
+
+    // the pool fills the top of the address space, see BasicCacheSimulator
+    static constexpr std::uint64_t TABLES_AT_TOP = ~std::uint64_t(0);
+};
+
+// two TLB levels and the page walker
+class Mmu
+{
+public:
+    void configure(MmuConfig mmuConfig)
+    {
+        config = mmuConfig;
+        l1.configure(config.l1);
+        l2.configure(config.l2);
+        pageTable.configure(config.tableBase);
+        pages.clear();
+    }
+
+    // translate the address, adding its cost to cycles. read(entryAddress)
+    // performs one walk reference and returns its latency.
+    template <class WalkRead>
+    std::uint64_t translate(std::uint64_t address, unsigned &cycles, WalkRead read)
+    {
+        unsigned shift = pageShift(config.pageSize);
+        std::uint64_t page = address >> shift;
+        accesses++;
+        pages.insert(page);
+
+        cycles += config.l1.latency;
+        if (l1.lookup(page))
+        {
+            l1Hits++;
+            return address;
+        }
+        cycles += config.l2.latency;
+        if (l2.lookup(page))
+        {
+            l2Hits++;
+            l1.insert(page);
+            return address;
+        }
+
+        // the walk ends at the level whose entries map a whole page
+        walks++;
+        unsigned leaf = 1 + (shift - 12) / PageTable::INDEX_BITS;
+        for (unsigned level = PageTable::LEVELS; level >= leaf; --level)
+        {
+            unsigned latency = read(pageTable.entryAddress(address, level));
+            walkReferences++;
+            walkCycles += latency;
+            cycles += latency;
+        }
+        l2.insert(page);
+        l1.insert(page);
+        return address;
+    }
+
+    // bytes mapped by a full TLB level
+    std::uint64_t reach(const Tlb &tlb) const
+    {
+        return std::uint64_t(tlb.getConfig().entries) << pageShift(config.pageSize);
+    }
+
+    void writeJSONFields(std::ostream &out) const
+    {
+        out << "  \"page_size\": \"" << pageSizeName(config.pageSize) << "\",\n";
+        out << "  \"dtlb_hits\": " << l1Hits << ",\n";
+        out << "  \"stlb_hits\": " << l2Hits << ",\n";
+        out << "  \"page_walks\": " << walks << ",\n";
+        out << "  \"walk_references\": " << walkReferences << ",\n";
+        out << "  \"walk_cycles\": " << walkCycles << ",\n";
+        out << "  \"pages_touched\": " << pages.size() << ",\n";
+        out << "  \"table_pages\": " << pageTable.tablePages() << ",\n";
+        out << "  \"dtlb_reach\": " << reach(l1) << ",\n";
+        out << "  \"stlb_reach\": " << reach(l2) << ",\n";
+    }
+
+    void writeCSVRows(std::ostream &out) const
+    {
+        out << "page_size," << pageSizeName(config.pageSize) << "\n";
+        out << "dtlb_hits," << l1Hits << "\n";
+        out << "stlb_hits," << l2Hits << "\n";
+        out << "page_walks," << walks << "\n";
+        out << "walk_references," << walkReferences << "\n";
+        out << "walk_cycles," << walkCycles << "\n";
+        out << "pages_touched," << pages.size() << "\n";
+        out << "table_pages," << pageTable.tablePages() << "\n";
+        out << "dtlb_reach," << reach(l1) << "\n";
+        out << "stlb_reach," << reach(l2) << "\n";
+    }
+
+    const MmuConfig &getConfig() const { return config; }
+    std::size_t pagesTouched() const { return pages.size(); }
+    std::size_t tablePages() const { return pageTable.tablePages(); }
+
+    void resetCounters() { accesses = l1Hits = l2Hits = walks = walkReferences = walkCycles = 0; }
+
+    std::uint64_t accesses = 0;
+    std::uint64_t l1Hits = 0;
+    std::uint64_t l2Hits = 0;
+    std::uint64_t walks = 0;
+    std::uint64_t walkReferences = 0;
+    std::uint64_t walkCycles = 0;
+
+    Tlb l1;
+    Tlb l2;
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(config, accesses, l1Hits, l2Hits, walks, walkReferences, walkCycles, l1, l2, pageTable, pages);
+    }
+
+private:
+    MmuConfig config;
+    PageTable pageTable;
+    std::unordered_set<std::uint64_t> pages;
+};
+
+#endif
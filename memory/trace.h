@@ -0,0 +1,409 @@
+// Packed binary trace format and a memory mapped reader.
+//
+// A trace file is a 24 byte header followed by fixed width records, all
+// little-endian:
+//   offset 0   magic "CTRC"
+//   offset 4   uint16 version
+//   offset 6   uint16 record kind
+//   offset 8   uint32 record size in bytes
+//   offset 12  uint32 reserved, zero
+//   offset 16  uint64 record count
+// An instruction record is the 32 bit instruction word.
+//
+// A delta trace holds the same instructions in variable length records and
+// gives 1, the shortest, as its record size. A lw or sw off $0 is a tag byte
+// 0b0WDrrrrr, W set for sw, rt in r, followed unless D is set by the change
+// of its immediate from the previous lw or sw as a zigzag varint; D reuses
+// the previous change, so a strided stream costs a byte per access. Any
+// other word is 0x80 followed by the word in four bytes.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "decode.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char TRACE_MAGIC[4] = {'C', 'T', 'R', 'C'};
+const std::uint16_t TRACE_VERSION = 1;
+const std::size_t TRACE_HEADER_BYTES = 24;
+
+// record kinds
+const std::uint16_t TRACE_INSTRUCTIONS = 1;
+const std::uint16_t TRACE_DELTA = 2;
+
+inline std::uint16_t loadLE16(const unsigned char *p)
+{
+    return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+inline std::uint32_t loadLE32(const unsigned char *p)
+{
+    return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+inline std::uint64_t loadLE64(const unsigned char *p)
+{
+    return std::uint64_t(loadLE32(p)) | (std::uint64_t(loadLE32(p + 4)) << 32);
+}
+
+inline void storeLE(unsigned char *p, std::uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+// write a header, the records must follow
+inline void writeTraceHeader(std::ostream &out, std::uint16_t kind, std::uint32_t recordBytes, std::uint64_t count)
+{
+    unsigned char header[TRACE_HEADER_BYTES] = {};
+    std::memcpy(header, TRACE_MAGIC, 4);
+    storeLE(header + 4, TRACE_VERSION, 2);
+    storeLE(header + 6, kind, 2);
+    storeLE(header + 8, recordBytes, 4);
+    storeLE(header + 16, count, 8);
+    out.write((const char *)header, TRACE_HEADER_BYTES);
+}
+
+inline void writeInstruction(std::ostream &out, std::uint32_t instruction)
+{
+    unsigned char record[4];
+    storeLE(record, instruction, 4);
+    out.write((const char *)record, 4);
+}
+
+// writes the records of a delta trace
+class DeltaWriter
+{
+public:
+    void write(std::ostream &out, std::uint32_t instruction)
+    {
+        // the trace's loads and stores all use base register $0
+        unsigned opcode = getOpcode(instruction);
+        unsigned base = (instruction >> 21) & 0x1F;
+        if ((opcode != OPCODE_LW && opcode != OPCODE_SW) || base != 0)
+        {
+            unsigned char record[5] = {0x80};
+            storeLE(record + 1, instruction, 4);
+            out.write((const char *)record, 5);
+            return;
+        }
+
+        std::int32_t immediate = std::int32_t(getImmediate(instruction));
+        std::int32_t delta = immediate - previous;
+        previous = immediate;
+        unsigned char record[4];
+        int bytes = 1;
+        record[0] = (unsigned char)((opcode == OPCODE_SW ? 0x40 : 0) | getRt(instruction));
+        if (delta == previousDelta)
+            record[0] |= 0x20;
+        else
+        {
+            std::uint32_t zigzag = (std::uint32_t(delta) << 1) ^ std::uint32_t(delta >> 31);
+            do
+            {
+                record[bytes++] = (unsigned char)((zigzag & 0x7F) | (zigzag > 0x7F ? 0x80 : 0));
+                zigzag >>= 7;
+            } while (zigzag);
+            previousDelta = delta;
+        }
+        out.write((const char *)record, bytes);
+    }
+
+private:
+    std::int32_t previous = 0;
+    std::int32_t previousDelta = 0;
+};
+
+// decodes the records of a delta trace in order
+class DeltaReader
+{
+public:
+    DeltaReader() {}
+    DeltaReader(const unsigned char *begin, const unsigned char *end, std::uint64_t count)
+        : cursor(begin), end(end), remaining(count)
+    {
+    }
+
+    // decode up to max instruction words, fewer at the end or at a
+    // truncated record
+    std::size_t read(std::uint32_t *words, std::size_t max)
+    {
+        std::size_t n = 0;
+        while (n < max && remaining && cursor < end)
+        {
+            unsigned char tag = *cursor++;
+            if (tag & 0x80)
+            {
+                if (end - cursor < 4)
+                    break;
+                words[n++] = loadLE32(cursor);
+                cursor += 4;
+            }
+            else
+            {
+                if (!(tag & 0x20))
+                {
+                    std::uint32_t zigzag = 0;
+                    unsigned shift = 0;
+                    unsigned char byte;
+                    do
+                    {
+                        if (cursor == end || shift > 28)
+                            return n;
+                        byte = *cursor++;
+                        zigzag |= std::uint32_t(byte & 0x7F) << shift;
+                        shift += 7;
+                    } while (byte & 0x80);
+                    previousDelta = std::int32_t(zigzag >> 1) ^ -std::int32_t(zigzag & 1);
+                }
+                previous += previousDelta;
+                unsigned opcode = tag & 0x40 ? OPCODE_SW : OPCODE_LW;
+                words[n++] = (std::uint32_t(opcode) << 26) | (std::uint32_t(tag & 0x1F) << 16) | (std::uint32_t(previous) & 0xFFFF);
+            }
+            remaining--;
+        }
+        return n;
+    }
+
+private:
+    const unsigned char *cursor = nullptr;
+    const unsigned char *end = nullptr;
+    std::uint64_t remaining = 0;
+    std::int32_t previous = 0;
+    std::int32_t previousDelta = 0;
+};
+
+// read only mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = std::size_t(fileSize.QuadPart);
+        if (length == 0)
+        {
+            CloseHandle(file);
+            return true;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping)
+            return false;
+        base = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        length = std::size_t(info.st_size);
+        if (length == 0)
+        {
+            // nothing to map, an empty view
+            ::close(fd);
+            return true;
+        }
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        base = (const unsigned char *)mapped;
+#endif
+        if (!base)
+            length = 0;
+        return base != nullptr;
+    }
+
+    void close()
+    {
+        if (base)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+#else
+            munmap((void *)base, length);
+#endif
+        }
+        base = nullptr;
+        length = 0;
+    }
+
+    const unsigned char *data() const { return base; }
+    std::size_t size() const { return length; }
+
+private:
+    const unsigned char *base = nullptr;
+    std::size_t length = 0;
+};
+
+// whether the mapped file starts like a binary trace, so one TraceFile
+// rejects is not read as text instead
+inline bool hasTraceMagic(const MappedFile &file)
+{
+    return file.size() >= 4 && std::memcmp(file.data(), TRACE_MAGIC, 4) == 0;
+}
+
+// read only view of a binary trace, mapped straight from the file
+class TraceFile
+{
+public:
+    // map the file and validate its header, false if it is not a trace of
+    // a known kind with that kind's record size
+    bool open(const std::string &path)
+    {
+        close();
+        if (!file.open(path))
+            return false;
+        const unsigned char *base = file.data();
+        if (file.size() < TRACE_HEADER_BYTES || std::memcmp(base, TRACE_MAGIC, 4) != 0 || loadLE16(base + 4) != TRACE_VERSION)
+        {
+            close();
+            return false;
+        }
+        kind = loadLE16(base + 6);
+        recordSize = loadLE32(base + 8);
+        count = loadLE64(base + 16);
+        if (recordSize == 0 || recordSize != recordBytesOf(kind) || count > (file.size() - TRACE_HEADER_BYTES) / recordSize)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        count = 0;
+    }
+
+    std::uint16_t recordKind() const { return kind; }
+    std::uint32_t recordBytes() const { return recordSize; }
+    std::uint64_t size() const { return count; }
+    const unsigned char *records() const { return file.data() + TRACE_HEADER_BYTES; }
+
+    std::uint32_t instruction(std::uint64_t i) const
+    {
+        return loadLE32(records() + i * 4);
+    }
+
+    // copy up to max instruction words starting at first
+    std::size_t instructions(std::uint64_t first, std::uint32_t *words, std::size_t max) const
+    {
+        std::size_t n = first < count ? std::size_t(count - first < max ? count - first : max) : 0;
+        const unsigned char *p = records() + first * 4;
+        for (std::size_t i = 0; i < n; ++i)
+            words[i] = loadLE32(p + i * 4);
+        return n;
+    }
+
+    // reader of the records of a delta trace from the first
+    DeltaReader deltas() const
+    {
+        return DeltaReader(records(), file.data() + file.size(), count);
+    }
+
+private:
+    // the record size each known kind is written with, 0 for unknown kinds
+    static std::uint32_t recordBytesOf(std::uint16_t recordKind)
+    {
+        switch (recordKind)
+        {
+        case TRACE_INSTRUCTIONS:
+            return 4;
+        case TRACE_DELTA:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    MappedFile file;
+    std::uint16_t kind = 0;
+    std::uint32_t recordSize = 0;
+    std::uint64_t count = 0;
+};
+
+// load every instruction of a binary or text trace into memory
+inline bool loadInstructions(const std::string &path, std::vector<std::uint32_t> &instructions)
+{
+    instructions.clear();
+
+    TraceFile trace;
+    if (trace.open(path))
+    {
+        if (trace.recordKind() == TRACE_DELTA)
+        {
+            instructions.resize(trace.size());
+            DeltaReader deltas = trace.deltas();
+            instructions.resize(deltas.read(instructions.data(), instructions.size()));
+            return true;
+        }
+        if (trace.recordKind() != TRACE_INSTRUCTIONS)
+            return false;
+        instructions.resize(trace.size());
+        for (std::uint64_t i = 0; i < trace.size(); ++i)
+            instructions[i] = trace.instruction(i);
+        return true;
+    }
+
+    // text traces are mapped and decoded in blocks
+    MappedFile text;
+    if (!text.open(path) || hasTraceMagic(text))
+        return false;
+    const char *cursor = (const char *)text.data();
+    const char *end = cursor + text.size();
+    std::uint32_t block[4096];
+    while (std::size_t n = decodeAscii(cursor, end, block, 4096))
+        instructions.insert(instructions.end(), block, block + n);
+    return true;
+}
+
+// decode the lw and sw instructions of a trace, skipping anything else
+inline std::vector<Access> decodeAccesses(const std::vector<std::uint32_t> &instructions)
+{
+    std::vector<Access> accesses(instructions.size());
+    std::size_t decoded = 0;
+    for (std::size_t i = 0; i < instructions.size();)
+    {
+        std::size_t n = decodeWords(&instructions[i], instructions.size() - i, &accesses[decoded]);
+        decoded += n;
+        i += n + 1;
+    }
+    accesses.resize(decoded);
+    return accesses;
+}
+
+#endif
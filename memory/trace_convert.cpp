@@ -0,0 +1,78 @@
+// Converts a text trace of 32 character binary instructions into the packed
+// binary trace format read by the simulator, or with --delta into the delta
+// coded format.
+//
+// usage: trace_convert [--delta] <input.txt> <output.trc>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "trace.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    bool delta = argc == 4 && string(argv[1]) == "--delta";
+    if (argc != 3 && !delta)
+    {
+        cerr << "usage: " << argv[0] << " [--delta] <input.txt> <output.trc>" << endl;
+        return 1;
+    }
+    argv += delta;
+
+    ifstream inputFile(argv[1]);
+    if (!inputFile.is_open())
+    {
+        cerr << "Unable to open file " << argv[1] << endl;
+        return 1;
+    }
+
+    // parse every instruction line, skipping blank ones
+    vector<uint32_t> instructions;
+    string line;
+    int lineNumber = 0;
+    while (getline(inputFile, line))
+    {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        if (line.size() < 32 || line.find_first_not_of("01") < 32)
+        {
+            cerr << argv[1] << ":" << lineNumber << ": expected 32 binary digits" << endl;
+            return 1;
+        }
+        instructions.push_back(parseInstruction(line.data()));
+    }
+
+    ofstream outputFile(argv[2], ios::binary);
+    if (!outputFile.is_open())
+    {
+        cerr << "Unable to open file " << argv[2] << endl;
+        return 1;
+    }
+
+    if (delta)
+    {
+        writeTraceHeader(outputFile, TRACE_DELTA, 1, instructions.size());
+        DeltaWriter writer;
+        for (uint32_t instruction : instructions)
+            writer.write(outputFile, instruction);
+    }
+    else
+    {
+        writeTraceHeader(outputFile, TRACE_INSTRUCTIONS, 4, instructions.size());
+        for (uint32_t instruction : instructions)
+            writeInstruction(outputFile, instruction);
+    }
+
+    if (!outputFile)
+    {
+        cerr << "Unable to write file " << argv[2] << endl;
+        return 1;
+    }
+    cout << instructions.size() << " instructions written to " << argv[2] << endl;
+    return 0;
+}
@@ -0,0 +1,205 @@
+// Synthetic access patterns generated in process.
+//
+// Each generator fills a vector of Access records touching about footprint
+// bytes of a region starting at address 0:
+//   sequential     consecutive words, wrapping at the footprint
+//   strided        every stride bytes, wrapping with a shifted start
+//   random         uniform over the lines of the footprint
+//   zipf           lines ranked by a power law of exponent zipfAlpha,
+//                  scattered so hot lines do not share sets
+//   pointer-chase  a random cycle through every line, one dependent load
+//                  after another
+//   matrix         C += A * B over three square int matrices, tiled
+//
+// The generators use their own random number generator, so a seed gives
+// the same trace on every host and compiler.
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "decode.h"
+
+enum class Pattern
+{
+    Sequential,
+    Strided,
+    Random,
+    Zipf,
+    PointerChase,
+    Matrix
+};
+
+const int PATTERN_COUNT = 6;
+
+inline const char *patternName(Pattern pattern)
+{
+    static const char *names[] = {"sequential", "strided", "random", "zipf", "pointer-chase", "matrix"};
+    return names[int(pattern)];
+}
+
+// the pattern with the name, false if there is none
+inline bool parsePattern(const std::string &name, Pattern &pattern)
+{
+    for (int i = 0; i < PATTERN_COUNT; ++i)
+    {
+        if (name == patternName(Pattern(i)))
+        {
+            pattern = Pattern(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+struct WorkloadConfig
+{
+    Pattern pattern = Pattern::Sequential;
+    std::uint64_t footprint = 1 << 20; // bytes
+    std::size_t count = 1 << 20;       // accesses
+    std::uint64_t stride = 256;        // bytes, strided
+    double zipfAlpha = 0.99;           // zipf
+    std::size_t tile = 32;             // elements, matrix
+    double writeFraction = 0.2;        // stores, except pointer-chase and matrix
+    std::uint64_t seed = 1;
+};
+
+// splitmix64, small and the same everywhere
+class WorkloadRandom
+{
+public:
+    explicit WorkloadRandom(std::uint64_t seed) : state(seed) {}
+
+    std::uint64_t next()
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, bound)
+    std::uint64_t below(std::uint64_t bound) { return bound ? next() % bound : 0; }
+
+    // uniform in [0, 1)
+    double unit() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    std::uint64_t state;
+};
+
+const std::uint64_t WORKLOAD_LINE_BYTES = 64;
+
+inline std::vector<Access> generateWorkload(const WorkloadConfig &config)
+{
+    std::vector<Access> trace(config.count);
+    WorkloadRandom random(config.seed);
+    std::uint64_t footprint = config.footprint < WORKLOAD_LINE_BYTES ? WORKLOAD_LINE_BYTES : config.footprint;
+    std::uint64_t lines = footprint / WORKLOAD_LINE_BYTES;
+    auto store = [&]() { return std::uint8_t(random.unit() < config.writeFraction); };
+
+    switch (config.pattern)
+    {
+    case Pattern::Sequential:
+        for (std::size_t i = 0; i < trace.size(); ++i)
+            trace[i] = {(std::uint64_t(i) * 4) % footprint, store(), 0};
+        break;
+
+    case Pattern::Strided:
+    {
+        // each pass over the footprint starts one word later
+        std::uint64_t stride = config.stride ? config.stride : 4;
+        std::uint64_t perPass = (footprint + stride - 1) / stride;
+        for (std::size_t i = 0; i < trace.size(); ++i)
+        {
+            std::uint64_t pass = i / perPass;
+            trace[i] = {((i % perPass) * stride + pass * 4) % footprint, store(), 0};
+        }
+        break;
+    }
+
+    case Pattern::Random:
+        for (std::size_t i = 0; i < trace.size(); ++i)
+            trace[i] = {random.below(lines) * WORKLOAD_LINE_BYTES + random.below(16) * 4, store(), 0};
+        break;
+
+    case Pattern::Zipf:
+    {
+        // inverse of the continuous power law CDF over ranks 1 to lines,
+        // then rank times an odd multiplier to scatter the ranks
+        double alpha = config.zipfAlpha;
+        double n = double(lines);
+        for (std::size_t i = 0; i < trace.size(); ++i)
+        {
+            double u = random.unit();
+            double rank = std::fabs(alpha - 1) < 1e-9 ? std::pow(n, u)
+                                                      : std::pow(u * (std::pow(n, 1 - alpha) - 1) + 1, 1 / (1 - alpha));
+            std::uint64_t line = std::uint64_t(rank) - 1;
+            line = (line < lines ? line : lines - 1) * 0x9E3779B1ull % lines;
+            trace[i] = {line * WORKLOAD_LINE_BYTES, store(), 0};
+        }
+        break;
+    }
+
+    case Pattern::PointerChase:
+    {
+        // Sattolo's algorithm gives a single cycle through every line
+        std::vector<std::uint32_t> next(lines);
+        for (std::uint64_t line = 0; line < lines; ++line)
+            next[line] = std::uint32_t(line);
+        for (std::uint64_t line = lines - 1; line > 0; --line)
+        {
+            std::uint64_t other = random.below(line);
+            std::uint32_t swap = next[line];
+            next[line] = next[other];
+            next[other] = swap;
+        }
+        std::uint64_t line = 0;
+        for (std::size_t i = 0; i < trace.size(); ++i)
+        {
+            trace[i] = {line * WORKLOAD_LINE_BYTES, 0, 0};
+            line = next[line];
+        }
+        break;
+    }
+
+    case Pattern::Matrix:
+    {
+        // three n x n matrices of 4 byte elements, row major, one after the
+        // other; each k step reads A[i][k], B[k][j] and C[i][j] and writes C
+        std::uint64_t n = std::uint64_t(std::sqrt(double(footprint) / 12));
+        n = n ? n : 1;
+        std::uint64_t tile = config.tile ? config.tile : n;
+        std::uint64_t a = 0, b = n * n * 4, c = 2 * n * n * 4;
+        std::size_t i = 0;
+        while (i < trace.size())
+        {
+            for (std::uint64_t ii = 0; ii < n && i < trace.size(); ii += tile)
+                for (std::uint64_t jj = 0; jj < n && i < trace.size(); jj += tile)
+                    for (std::uint64_t kk = 0; kk < n && i < trace.size(); kk += tile)
+                        for (std::uint64_t r = ii; r < ii + tile && r < n && i < trace.size(); ++r)
+                            for (std::uint64_t col = jj; col < jj + tile && col < n && i < trace.size(); ++col)
+                                for (std::uint64_t k = kk; k < kk + tile && k < n && i < trace.size(); ++k)
+                                {
+                                    const Access step[] = {{a + (r * n + k) * 4, 0, 0},
+                                                           {b + (k * n + col) * 4, 0, 0},
+                                                           {c + (r * n + col) * 4, 0, 0},
+                                                           {c + (r * n + col) * 4, 1, 0}};
+                                    for (const Access &access : step)
+                                    {
+                                        if (i < trace.size())
+                                            trace[i++] = access;
+                                    }
+                                }
+        }
+        break;
+    }
+    }
+    return trace;
+}
+
+#endif
@@ -0,0 +1,143 @@
+// Write policies and a coalescing write buffer.
+//
+// A write hit either marks the line dirty and defers the write to its
+// eviction (write-back) or also sends the word to the next level at once
+// (write-through). A write miss either fills the line first (allocate) or
+// only sends the word down (no-allocate).
+//
+// WriteBuffer models the traffic of writes leaving a cache, not their data:
+// callers update the next level directly and report each write here. Writes
+// to a line that already has a pending entry merge into it, so only the
+// words still pending when an entry drains count as bytes written.
+
+#ifndef WRITE_POLICY_H
+#define WRITE_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class WritePolicy
+{
+    WriteBack,
+    WriteThrough
+};
+
+enum class WriteMiss
+{
+    NoAllocate,
+    Allocate
+};
+
+inline const char *writePolicyName(WritePolicy policy)
+{
+    return policy == WritePolicy::WriteThrough ? "write-through" : "write-back";
+}
+
+inline const char *writeMissName(WriteMiss miss)
+{
+    return miss == WriteMiss::Allocate ? "allocate" : "no-allocate";
+}
+
+class WriteBuffer
+{
+public:
+    // entries of 0 sends every write down as it happens
+    explicit WriteBuffer(std::size_t entries = 0, std::size_t lineBytes = 4)
+    {
+        configure(entries, lineBytes);
+    }
+
+    void configure(std::size_t bufferEntries, std::size_t bufferLineBytes)
+    {
+        entries = bufferEntries;
+        lineBytes = bufferLineBytes;
+        pending.assign(entries, Entry());
+        oldest = 0;
+        count = 0;
+    }
+
+    // record bytes written at the address, which must not cross a line,
+    // returning the bytes that left the buffer as a result
+    std::uint64_t write(std::uint64_t address, std::size_t bytes)
+    {
+        writes++;
+        if (entries == 0)
+            return bytes;
+
+        std::uint64_t line = address / lineBytes;
+        std::uint64_t words = wordMask(address, bytes);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Entry &entry = pending[(oldest + i) % entries];
+            if (entry.line == line)
+            {
+                coalesced++;
+                entry.words |= words;
+                return 0;
+            }
+        }
+
+        std::uint64_t drained = 0;
+        if (count == entries)
+            drained = drainOldest();
+        pending[(oldest + count) % entries] = {line, words};
+        count++;
+        return drained;
+    }
+
+    // empty the buffer, returning the bytes written
+    std::uint64_t drain()
+    {
+        std::uint64_t drained = 0;
+        while (count)
+            drained += drainOldest();
+        return drained;
+    }
+
+    std::size_t size() const { return count; }
+
+    std::uint64_t writes = 0;    // writes reported
+    std::uint64_t coalesced = 0; // writes merged into a pending entry
+
+    void resetCounters() { writes = coalesced = 0; }
+
+    // checkpoint state, see checkpoint.h
+    template <class Archive>
+    void transfer(Archive &archive)
+    {
+        archive(entries, lineBytes, pending, oldest, count, writes, coalesced);
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t line = 0;
+        std::uint64_t words = 0; // one bit per pending 4 byte word
+    };
+
+    std::uint64_t wordMask(std::uint64_t address, std::size_t bytes) const
+    {
+        std::size_t first = (address % lineBytes) / 4;
+        std::size_t count = (bytes + 3) / 4;
+        std::uint64_t mask = count >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << count) - 1;
+        return mask << first;
+    }
+
+    std::uint64_t drainOldest()
+    {
+        std::uint64_t bytes = std::uint64_t(__builtin_popcountll(pending[oldest].words)) * 4;
+        oldest = (oldest + 1) % entries;
+        count--;
+        return bytes;
+    }
+
+    std::size_t entries = 0;
+    std::size_t lineBytes = 4;
+    // ring of entries slots, count of them pending from oldest on
+    std::vector<Entry> pending;
+    std::size_t oldest = 0;
+    std::size_t count = 0;
+};
+
+#endif